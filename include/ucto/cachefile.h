@@ -0,0 +1,61 @@
+/*
+  Copyright (c) 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_CACHEFILE_H
+#define UCTO_CACHEFILE_H
+
+#include <ctime>
+#include <string>
+
+namespace Tokenizer {
+
+  // Helpers for the compiled files in the local cachedir, shared by the
+  // settings (Setting::save_compiled()) and the language fingerprints
+  // (LanguageIdentifier::save_compiled()).
+
+  // the local cachedir: $XDG_CACHE_HOME/ucto/, or else ~/.cache/ucto/
+  std::string local_cache_dir();
+
+  // the absolute path of a file, without symbolic links. The name itself
+  // when it can't be resolved
+  std::string full_path( const std::string& );
+
+  // a read only file in memory, unmapped when we are done
+  class MappedFile {
+  public:
+    MappedFile(): data( 0 ), size( 0 ), mtime( 0 ){};
+    ~MappedFile();
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+    bool open( const std::string& );
+    const char *data;
+    size_t size;
+    time_t mtime;   // the modification time of the file
+  };
+
+} // namespace Tokenizer
+
+#endif
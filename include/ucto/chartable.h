@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_CHARTABLE_H
+#define UCTO_CHARTABLE_H
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include "unicode/umachine.h"
+
+namespace Tokenizer {
+
+  // The character properties the tokenizer asks for, for every character
+  // it sees. Instead of asking ICU (and walking the separator and quote
+  // lists) over and over, we look them up in a table.
+  //
+  // The Basic Multilingual Plane is stored as a flat table. The rare
+  // characters beyond it are handed to ICU, with a small map for the
+  // flags that were added explicitly.
+  class CharTable {
+  public:
+    enum Flag : uint16_t {
+      SEPARATOR       = 1<<0,  // splits the input in words
+      PUNCT           = 1<<1,  // u_ispunct()
+      DIGIT           = 1<<2,  // u_isdigit()
+      OTHER_NUMBER    = 1<<3,  // general category No
+      ALPHA           = 1<<4,  // u_isalpha()
+      UPPER           = 1<<5,  // u_isupper() or u_istitle()
+      BOS             = 1<<6,  // UPPER, in a script that distinguishes case
+      QUOTE           = 1<<7,  // the Quotation_Mark property, or ` or ´
+      QUOTE_OPEN      = 1<<8,  // part of a configured opening quote
+      QUOTE_CLOSE     = 1<<9,  // part of a configured closing quote
+      EMOTICON        = 1<<10, // in the Emoticons block
+      PICTO           = 1<<11, // in the Misc. Symbols and Pictographs block
+      CURRENCY        = 1<<12, // general category Sc
+      SYMBOL          = 1<<13, // general category Sc, Sm, Sk or So
+      NONSPACING_MARK = 1<<14, // general category Mn
+      BOM             = 1<<15  // a byte order mark
+    };
+    typedef uint16_t Flags;
+    CharTable();
+    // the table with just the Unicode properties, and the space-like
+    // characters as SEPARATOR
+    static const CharTable& unicode();
+    Flags flags( UChar32 c ) const {
+      if ( c >= 0 && c < BMP_SIZE ){
+	return bmp[c];
+      }
+      return supplementary( c );
+    };
+    bool is( UChar32 c, Flags mask ) const {
+      return ( flags( c ) & mask ) != 0;
+    };
+    void add( UChar32, Flags );
+    void remove( Flags );
+    void reset( Flags );
+    // true when none of the ASCII letters has any of the flags in mask
+    bool plain_letters( Flags mask ) const {
+      return ( letter_flags & mask ) == 0;
+    };
+    // the number of ASCII letters (a-z, A-Z) at the start of buf
+    static int32_t ascii_letters( const UChar *buf, int32_t len );
+  private:
+    static const UChar32 BMP_SIZE = 0x10000;
+    explicit CharTable( bool );
+    static Flags compute( UChar32 );
+    Flags supplementary( UChar32 ) const;
+    void collect_letter_flags();
+    std::vector<Flags> bmp;
+    std::map<UChar32,Flags> added; // flags added beyond the BMP
+    Flags removed;                 // flags removed beyond the BMP
+    Flags letter_flags;            // the flags of all ASCII letters, OR-ed
+  };
+
+} // namespace Tokenizer
+
+#endif
@@ -0,0 +1,101 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_DECODER_H
+#define UCTO_DECODER_H
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include "unicode/unistr.h"
+#include "unicode/ucnv.h"
+
+namespace Tokenizer {
+
+  class uCodingError: public std::runtime_error {
+  public:
+    explicit uCodingError( const std::string& s ):
+      runtime_error( "ucto: coding problem:" + s ){};
+  };
+
+  // some lines of the input, for handing them to another thread
+  struct LineBlock {
+    std::vector<icu::UnicodeString> lines;
+    // the lines with ill-formed UTF-8: their index in lines, and the
+    // stream offsets of the bad sequences
+    std::vector<std::pair<size_t,std::vector<uint64_t>>> bad;
+  };
+
+  // Reads an input stream in large blocks, and decodes it with one ICU
+  // converter, which is opened only once for the whole stream. UTF-8,
+  // by far the most common, is decoded directly, without a converter.
+  // A byte order mark at the start of the stream overrules the encoding
+  // we are given. The decoded text is handed out line by line.
+  //
+  // An ill-formed UTF-8 sequence is replaced by U+FFFD. For every line,
+  // bad_sequences() tells where in the stream the ones it contains started.
+  class InputDecoder {
+  public:
+    InputDecoder( std::istream&, const std::string& );
+    ~InputDecoder();
+    InputDecoder( const InputDecoder& ) = delete;
+    InputDecoder& operator=( const InputDecoder& ) = delete;
+    bool getline( icu::UnicodeString& );
+    bool getlines( LineBlock&, size_t );
+    bool reads( const std::istream& is ) const { return &is == &in; };
+    const std::string& encoding() const { return _encoding; };
+    // the byte offsets of the ill-formed UTF-8 in the last line
+    const std::vector<uint64_t>& bad_sequences() const { return line_bad; };
+  private:
+    static const size_t BLOCK_SIZE = 64*1024;
+    bool fill();
+    size_t decode_utf8( const char *, size_t, uint64_t, bool );
+    void take_bad( int32_t );
+    std::istream& in;
+    std::string _encoding;
+    UConverter *converter;      // 0 for UTF-8
+    std::vector<char> bytes;    // the last block read
+    size_t bytes_used;          // the part of it already decoded
+    uint64_t offset;            // the stream offset of bytes[0]
+    std::vector<UChar> chars;   // room to decode into
+    icu::UnicodeString decoded; // decoded, but not handed out yet
+    int32_t pos;                // the start of the next line in decoded
+    bool at_end;
+    struct BadSequence {
+      int32_t at;               // the U+FFFD in decoded
+      uint64_t offset;          // the stream offset of the bad bytes
+    };
+    std::deque<BadSequence> pending_bad; // not handed out yet
+    std::vector<uint64_t> line_bad;
+  };
+
+} // namespace Tokenizer
+
+#endif
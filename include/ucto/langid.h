@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_LANGID_H
+#define UCTO_LANGID_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "unicode/unistr.h"
+#include "ticcutils/LogStream.h"
+
+namespace Tokenizer {
+
+  // Guesses the language of a text the way TextCat does: the 400 most
+  // frequent n-grams (1 to 5 characters) of the text are compared with the
+  // fingerprint of every language, using the 'out-of-place' measure. It
+  // uses the same textcat.cfg and fingerprint (.lm) files, but doesn't need
+  // libtextcat.
+  //
+  // Only the languages it is created for are considered. Their fingerprints
+  // are put in one flat hash table, which holds a row with the rank in
+  // every language for each n-gram. So a text costs one lookup per n-gram,
+  // and one addition per language, done for all languages at once.
+  //
+  // Reading the .lm files can be avoided with save_compiled(), which stores
+  // hashed fingerprints in the local cachedir. Later runs map that file into
+  // memory and use it as it is, as long as it is newer than the textcat.cfg
+  // and the .lm files.
+  //
+  // get_language() changes nothing, so threads may share one identifier.
+  class LanguageIdentifier {
+  public:
+    LanguageIdentifier( const std::string&,
+			const std::vector<std::string>&,
+			TiCC::LogStream * = 0,
+			TiCC::LogStream * = 0 );
+    LanguageIdentifier( const LanguageIdentifier& ) = delete;
+    LanguageIdentifier& operator=( const LanguageIdentifier& ) = delete;
+    bool isInit() const { return !codes.empty(); };
+    const std::vector<std::string>& languages() const { return codes; };
+    bool from_compiled() const { return compiled; };
+    const std::string& config() const { return cfg_name; };
+    std::string get_language( const icu::UnicodeString& ) const;
+    static std::string compiled_name( const std::string& );
+    static bool save_compiled( const std::string&, TiCC::LogStream * = 0 );
+  private:
+    int32_t find_row( uint64_t ) const;
+    std::string cfg_name;
+    std::vector<std::string> codes; // the languages considered
+    size_t width;                   // codes.size(), rounded up
+    std::vector<uint64_t> keys;     // the n-gram hashes, 0 for a free slot
+    std::vector<int32_t> rows;      // the row of every key
+    std::vector<int32_t> ranks;     // width ranks per row
+    bool compiled;
+  };
+
+} // namespace Tokenizer
+
+#endif
@@ -28,6 +28,7 @@
 #define TEXTCAT_H
 
 #include <cstring>
+#include <mutex>
 
 #ifdef HAVE_TEXTCAT
   #ifdef HAVE_OLD_TEXTCAT
@@ -58,6 +59,8 @@ class TextCat {
   std::string cfName;
   bool debug;
   TiCC::LogStream *dbg;
+  // textcat_Classify() isn't thread safe
+  mutable std::mutex classify_lock;
 };
 
 #endif // TEXTCAT_H
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_QUEUE_H
+#define UCTO_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace Tokenizer {
+
+  // A bounded queue between exactly one producer thread and exactly one
+  // consumer thread. It needs no locks: the producer only moves the tail,
+  // the consumer only moves the head.
+  //
+  // push() waits while the queue is full, pop() while it is empty. After
+  // close(), push() fails at once, and pop() fails as soon as the queue
+  // is empty. Either side may close the queue, the producer at the end of
+  // its data, the consumer when it gives up.
+  template <class T>
+  class SPSCQueue {
+  public:
+    explicit SPSCQueue( size_t capacity ):
+      slots( capacity + 1 ),
+      head( 0 ),
+      tail( 0 ),
+      closed( false )
+    {};
+    SPSCQueue( const SPSCQueue& ) = delete;
+    SPSCQueue& operator=( const SPSCQueue& ) = delete;
+    bool push( T&& item ){
+      const size_t t = tail.load( std::memory_order_relaxed );
+      const size_t next = ( t + 1 ) % slots.size();
+      size_t tries = 0;
+      while ( next == head.load( std::memory_order_acquire ) ){
+	if ( closed.load( std::memory_order_acquire ) ){
+	  return false;
+	}
+	pause( tries );
+      }
+      if ( closed.load( std::memory_order_acquire ) ){
+	return false;
+      }
+      slots[t] = std::move( item );
+      tail.store( next, std::memory_order_release );
+      return true;
+    };
+    bool pop( T& item ){
+      const size_t h = head.load( std::memory_order_relaxed );
+      size_t tries = 0;
+      while ( h == tail.load( std::memory_order_acquire ) ){
+	if ( closed.load( std::memory_order_acquire ) ){
+	  // the producer may have pushed just before it closed
+	  if ( h == tail.load( std::memory_order_acquire ) ){
+	    return false;
+	  }
+	  break;
+	}
+	pause( tries );
+      }
+      item = std::move( slots[h] );
+      head.store( ( h + 1 ) % slots.size(), std::memory_order_release );
+      return true;
+    };
+    void close(){ closed.store( true, std::memory_order_release ); };
+  private:
+    static void pause( size_t& tries ){
+      // the other side is usually busy with I/O or tokenizing, so don't
+      // burn a CPU waiting for it
+      if ( ++tries < 16 ){
+	std::this_thread::yield();
+      }
+      else {
+	std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+      }
+    };
+    std::vector<T> slots;                 // one stays empty
+    alignas(64) std::atomic<size_t> head; // the next to pop
+    alignas(64) std::atomic<size_t> tail; // the next to push
+    std::atomic<bool> closed;
+  };
+
+} // namespace Tokenizer
+
+#endif
@@ -0,0 +1,103 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_RULESET_H
+#define UCTO_RULESET_H
+
+#include <vector>
+#include <bitset>
+#include "unicode/unistr.h"
+#include "unicode/uniset.h"
+
+namespace TiCC {
+  class LogStream;
+}
+
+namespace Tokenizer {
+
+  using namespace icu;
+
+  class Rule;
+
+  // A compiled view on all the rules of one Setting.
+  //
+  // Every rule pattern is analysed once, to find the character classes
+  // any match of that rule MUST contain (and, for anchored rules, the
+  // class of the very first character of the input). Tokenizing a word
+  // then starts with ONE scan over that word, which tells us which
+  // rules can possibly match. Only those are tried, still in the
+  // [RULE-ORDER] sequence, so the first matching rule still wins.
+  class RuleSet {
+  public:
+    static const size_t MAX_CLASSES = 128;
+    typedef std::bitset<MAX_CLASSES> ClassMask;
+    struct Signature {
+      ClassMask all;   // classes seen anywhere in the word
+      ClassMask first; // classes of the first character
+    };
+    RuleSet();
+    void compile( const std::vector<Rule *>&, int, TiCC::LogStream * );
+    Signature scan( const UnicodeString& ) const;
+    bool may_match( size_t index, const Signature& sig ) const {
+      // rules that are out of range (or unknown) must always be tried
+      if ( index >= required.size() ){
+	return true;
+      }
+      return ( ( required[index] & sig.all ) == required[index] )
+	&& ( ( required_first[index] & sig.first ) == required_first[index] );
+    }
+    size_t size() const { return required.size(); };
+    size_t filtered() const;
+    // access to the compiled data, to store and restore it
+    const std::vector<UnicodeSet>& get_classes() const { return classes; };
+    const std::vector<ClassMask>& get_required() const { return required; };
+    const std::vector<ClassMask>& get_required_first() const {
+      return required_first; };
+    void restore( const std::vector<UnicodeSet>&,
+		  const std::vector<ClassMask>&,
+		  const std::vector<ClassMask>& );
+  private:
+    static const UChar32 LOW_TABLE_SIZE = 0x800;
+    void fill_low_table();
+    ClassMask char_mask( UChar32 ) const;
+    int class_index( const UnicodeSet& );
+    std::vector<UnicodeSet> classes;
+    std::vector<ClassMask> required;
+    std::vector<ClassMask> required_first;
+    std::vector<ClassMask> low_table;
+  };
+
+  // Turn a list of alternatives (like the [TOKENS] or [ABBREVIATIONS] of a
+  // configfile) into ONE regular expression. Literal entries are stored
+  // in a trie, which is then written out as nested groups, so matching
+  // costs about the length of the entry, not the length of the list.
+  // The regex semantics of the plain alternation (leftmost entry wins)
+  // are kept.
+  UnicodeString compile_list( const std::vector<UnicodeString>& );
+
+} // namespace Tokenizer
+
+#endif
@@ -27,9 +27,18 @@
 #ifndef UCTO_SETTING_H
 #define UCTO_SETTING_H
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "unicode/regex.h"
+#include "unicode/utf16.h"
+#include "ucto/ruleset.h"
+#include "ucto/chartable.h"
+
 namespace TiCC {
   class LogStream;
-  class UnicodeRegexMatcher;
   class UniFilter;
 }
 
@@ -42,18 +51,29 @@ namespace Tokenizer {
   class Rule {
     friend std::ostream& operator<< (std::ostream&, const Rule& );
   public:
-  Rule(): regexp(0){
+    // a part of a matched string: an offset and a length
+    struct Span {
+      Span( int32_t s=0, int32_t l=0 ): start(s), length(l) {};
+      bool empty() const { return length <= 0; };
+      int32_t start;
+      int32_t length;
     };
+    Rule(){};
     Rule( const UnicodeString& id, const UnicodeString& pattern);
-    ~Rule();
     UnicodeString id;
     UnicodeString pattern;
-    TiCC::UnicodeRegexMatcher *regexp;
-    bool matchAll( const UnicodeString&,
-		   UnicodeString&,
-		   UnicodeString&,
-		   std::vector<UnicodeString>& );
+    // a RegexMatcher can't be shared between threads, so every user of
+    // the Rule creates its own
+    RegexMatcher *new_matcher() const;
+    bool matchAll( RegexMatcher&,
+		   const UnicodeString&,
+		   Span&,
+		   Span&,
+		   std::vector<Span>& ) const;
   private:
+    // compiled only once in the process for every distinct pattern, and
+    // shared by all Rules with that pattern
+    std::shared_ptr<const RegexPattern> regexp;
     Rule( const Rule& ) = delete; // inhibit copies
     Rule& operator=( const Rule& ) = delete; // inhibit copies
   };
@@ -61,36 +81,95 @@ namespace Tokenizer {
 
   class Quoting {
     friend std::ostream& operator<<( std::ostream&, const Quoting& );
+  public:
     struct QuotePair {
       UnicodeString openQuote;
       UnicodeString closeQuote;
     };
-  public:
     void add( const UnicodeString&, const UnicodeString& );
     UnicodeString lookupOpen( const UnicodeString &) const;
     UnicodeString lookupClose( const UnicodeString & ) const;
+    bool isQuote( UChar32 c ) const {
+      // a quote by nature, or a part of one of our quote pairs
+      return chars.is( c, CharTable::QUOTE
+		       | CharTable::QUOTE_OPEN | CharTable::QUOTE_CLOSE );
+    };
+    bool plainLetters() const {
+      // no ASCII letter is part of a quote
+      return chars.plain_letters( CharTable::QUOTE
+				  | CharTable::QUOTE_OPEN
+				  | CharTable::QUOTE_CLOSE );
+    };
     bool empty() const { return _quotes.empty(); };
-    bool emptyStack() const { return quotestack.empty(); };
-    void clearStack() { quoteindexstack.clear(); quotestack.clear(); };
-    int lookup( const UnicodeString&, int& );
+    const std::vector<QuotePair>& get_quotes() const { return _quotes; };
+  private:
+    std::vector<QuotePair> _quotes;
+    CharTable chars; // with the characters of _quotes marked
+  };
+
+  // The quotes seen in the input that are not resolved yet. This belongs
+  // to the input, not to the Quoting of a Setting, which is shared.
+  class QuoteStack {
+  public:
+    bool empty() const { return quotestack.empty(); };
+    void clear() {
+      quoteindexstack.clear();
+      quotestack.clear();
+      stackbase = 0;
+    };
+    int lookup( const UnicodeString&, int& ) const;
     void eraseAtPos( int pos ) {
       quotestack.erase( quotestack.begin()+pos );
       quoteindexstack.erase( quoteindexstack.begin()+pos );
     }
-    void flushStack( int ); //renamed from eraseBeforeIndex
+    void flush( int ); //renamed from eraseBeforeIndex
     void push( int i, UChar32 c ){
-      quoteindexstack.push_back(i);
+      quoteindexstack.push_back( stackbase + i );
       quotestack.push_back(c);
     }
   private:
-    std::vector<QuotePair> _quotes;
-    std::vector<int> quoteindexstack;
-    std::vector<UChar32> quotestack;
+    // the token indices on the stack are counted from the start of the
+    // input. stackbase is the number of tokens flushed since, so
+    // renumbering after a flush is just a matter of raising it.
+    // The indices are pushed in increasing order.
+    std::deque<int64_t> quoteindexstack;
+    std::deque<UChar32> quotestack;
+    int64_t stackbase = 0;
+  };
+
+  // The FILTER entries, compiled for a fast lookup. A bit for every BMP
+  // code unit tells whether a character starting with it is filtered at
+  // all, so most characters are passed without a lookup.
+  class FilterTable {
+  public:
+    FilterTable(): bits( BMP_SIZE/64 ) {};
+    void compile( TiCC::UniFilter&, const std::vector<UnicodeString>& );
+    bool empty() const { return replacements.empty(); };
+    bool marked( UChar u ) const {
+      return ( bits[u >> 6] >> ( u & 63 ) ) & 1;
+    };
+    // the replacement of c, or 0 when c isn't filtered
+    const UnicodeString *find( UChar32 c ) const {
+      if ( !marked( U_IS_BMP( c ) ? c : U16_LEAD( c ) ) ){
+	return 0;
+      }
+      auto it = replacements.find( c );
+      return it == replacements.end() ? 0 : &it->second;
+    };
+  private:
+    static const size_t BMP_SIZE = 0x10000;
+    std::vector<uint64_t> bits;
+    std::unordered_map<UChar32,UnicodeString> replacements;
   };
 
   class Setting {
   public:
     ~Setting();
+    static std::shared_ptr<const Setting> acquire( const std::string&,
+						    const std::string&,
+						    int,
+						    TiCC::LogStream*,
+						    TiCC::LogStream* );
     bool read( const std::string&,
 	       const std::string&,
 	       int,
@@ -100,27 +179,65 @@ namespace Tokenizer {
     bool read_filters( const std::string& );
     bool read_quotes( const std::string& );
     bool read_eosmarkers( const std::string& );
-    bool read_abbreviations( const std::string&,  UnicodeString& );
+    bool read_abbreviations( const std::string&,
+			     std::vector<UnicodeString>& );
     void add_rule( const UnicodeString&,
 		   const std::vector<UnicodeString>& );
     void sort_rules( std::map<UnicodeString, Rule *>&,
 		     const std::vector<UnicodeString>& );
     static std::set<std::string> installed_languages();
+    static std::string read_version( const std::string& );
+    static std::string compiled_name( const std::string&,
+				      const std::string& = "" );
+    bool save_compiled( const std::string& ) const;
+    bool load_compiled( const std::string&,
+			const std::string&,
+			const std::string& );
     UnicodeString eosmarkers;
     std::map<UnicodeString, UnicodeString> macros;
     std::vector<Rule *> rules;
     std::map<UnicodeString, Rule *> rulesmap;
     std::map<UnicodeString, int> rules_index;
+    RuleSet ruleset;
     std::string splitter;
     Quoting quotes;
     TiCC::UniFilter filter;
+    FilterTable filter_table; // filter, compiled
     std::string set_file; // the name of the settingsfile
     std::string version;  // the version of the datafile
+    std::vector<std::string> source_files; // the configfile and its includes
+    std::vector<UnicodeString> filter_lines; // all FILTER entries
+    std::string add_tokens_file; // the file with additional TOKENS
     int tokDebug;
+    // only used while reading. A shared Setting may outlive them
     TiCC::LogStream *theErrLog;
     TiCC::LogStream *theDbgLog;
   };
 
+  // A Setting that is only read when it is first needed, by get(). Any
+  // number of threads may ask for it at the same time. It is read only
+  // once, and reading it doesn't hold up other LazySettings.
+  class LazySetting {
+  public:
+    LazySetting( const std::string& name, const std::string& add ):
+      settings_name( name ), add_tokens( add ), ptr( 0 ), failed( false ) {};
+    explicit LazySetting( const std::shared_ptr<const Setting>& );
+    LazySetting( const LazySetting& ) = delete;
+    LazySetting& operator=( const LazySetting& ) = delete;
+    const Setting *get( int, TiCC::LogStream*, TiCC::LogStream* ) const;
+    // the Setting when it is read already, 0 otherwise
+    const Setting *peek() const { return ptr.load( std::memory_order_acquire ); };
+    const std::string& name() const { return settings_name; };
+    std::string version() const;
+  private:
+    std::string settings_name;
+    std::string add_tokens;
+    mutable std::mutex lock;
+    mutable std::shared_ptr<const Setting> setting;
+    mutable std::atomic<const Setting*> ptr; // setting, once it is read
+    mutable bool failed;
+  };
+
 } // namespace Tokenizer
 
 #endif
@@ -0,0 +1,100 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+#ifndef UCTO_SYMBOLS_H
+#define UCTO_SYMBOLS_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include "unicode/unistr.h"
+
+namespace Tokenizer {
+
+  // a small number, standing for a string in a SymbolTable
+  typedef uint16_t Symbol;
+
+  struct UnicodeHash {
+    size_t operator()( const icu::UnicodeString& us ) const {
+      return us.hashCode();
+    }
+  };
+
+  // A table of strings which are used over and over again, like the types
+  // of Tokens and the language codes. Every string is stored only once, and
+  // is referred to by a Symbol, which is cheap to copy and to compare.
+  //
+  // Strings are only added, never removed, so a Symbol stays valid as long
+  // as the table exists. Adding is thread-safe. Getting the string of a
+  // Symbol needs no locking, because the strings are stored in blocks
+  // that never move.
+  template <class S, class Hash = std::hash<S>>
+  class SymbolTable {
+  public:
+    Symbol intern( const S& s ){
+      {
+	std::shared_lock<std::shared_mutex> lock( mtx );
+	auto it = index.find( s );
+	if ( it != index.end() ){
+	  return it->second;
+	}
+      }
+      std::unique_lock<std::shared_mutex> lock( mtx );
+      auto it = index.find( s );
+      if ( it != index.end() ){
+	return it->second;
+      }
+      if ( count == MAX_SYMBOLS ){
+	throw std::overflow_error( "ucto: too many different symbols" );
+      }
+      const Symbol result = count;
+      std::unique_ptr<S[]>& block = blocks[result / BLOCK_SIZE];
+      if ( !block ){
+	block.reset( new S[BLOCK_SIZE] );
+      }
+      block[result % BLOCK_SIZE] = s;
+      index.emplace( s, result );
+      ++count;
+      return result;
+    };
+    const S& str( Symbol sym ) const {
+      return blocks[sym / BLOCK_SIZE][sym % BLOCK_SIZE];
+    };
+  private:
+    static const size_t BLOCK_SIZE = 256;
+    static const size_t MAX_SYMBOLS = 65536;
+    std::unique_ptr<S[]> blocks[MAX_SYMBOLS / BLOCK_SIZE];
+    std::unordered_map<S,Symbol,Hash> index;
+    size_t count = 0;
+    std::shared_mutex mtx;
+  };
+
+} // namespace Tokenizer
+
+#endif
@@ -28,14 +28,25 @@
 #define UCTO_TOKENIZE_H
 
 #include <vector>
+#include <deque>
 #include <set>
 #include <map>
+#include <list>
+#include <unordered_map>
 #include <sstream>
 #include <stdexcept>
+#include <cstdint>
+#include <memory>
+#include "unicode/normalizer2.h"
 #include "libfolia/folia.h"
 #include "ticcutils/LogStream.h"
 #include "ticcutils/Unicode.h"
 #include "ucto/setting.h"
+#include "ucto/symbols.h"
+#include "ucto/decoder.h"
+#include "ucto/writer.h"
+#include "ucto/queue.h"
+#include "ucto/langid.h"
 
 class TextCat;
 
@@ -45,6 +56,8 @@ namespace Tokenizer {
 
   const std::string Version();
   const std::string VersionName();
+  // deprecated: use TokenizerClass::setKeepQuotedSpaces(). Only the
+  // initial value of a new TokenizerClass is taken from it
   extern bool keep_quoted_spaces;
 
   enum TokenRole {
@@ -89,7 +102,6 @@ namespace Tokenizer {
   class Token {
     friend std::ostream& operator<< (std::ostream&, const Token& );
   public:
-    UnicodeString type;
     UnicodeString us;
     TokenRole role;
     Token( const UnicodeString&,
@@ -99,9 +111,88 @@ namespace Tokenizer {
     Token( const UnicodeString&,
 	   const UnicodeString&,
 	   const std::string& = "" );
-    std::string lang_code;                // ISO 639-3 language code
+    Token( const UnicodeString&,
+	   const UnicodeString&,
+	   TokenRole,
+	   Symbol );
+    const UnicodeString& type() const;     // like WORD or PUNCTUATION
+    const std::string& lang_code() const;  // ISO 639-3 language code
+    // the type and the language code are stored as Symbols
+    Symbol type_symbol() const { return _type; };
+    Symbol lang_symbol() const { return _lang; };
+    static Symbol intern_type( const UnicodeString& );
+    static Symbol intern_language( const std::string& );
     std::string texttostring() const;
     std::string typetostring() const ;
+  private:
+    Symbol _type;
+    Symbol _lang;
+  };
+
+  // A bounded LRU cache, remembering how a whitespace delimited word was
+  // split into Tokens. Text is full of repetitions, so most words don't
+  // need to go through all the rules again.
+  class WordCache {
+  public:
+    struct Entry {
+      std::vector<Token> tokens;  // the resulting tokens
+      bool unspace_previous;      // remove NOSPACE from the token before
+    };
+    explicit WordCache( size_t = 0 );
+    size_t set_capacity( size_t );
+    size_t capacity() const { return _capacity; };
+    size_t size() const { return lookup.size(); };
+    size_t hits() const { return _hits; };
+    size_t misses() const { return _misses; };
+    void clear();
+    const Entry *find( Symbol, const UnicodeString&, int );
+    void insert( Symbol, const UnicodeString&, int, const Entry& );
+  private:
+    struct Key {
+      Symbol lang;
+      UnicodeString word;
+      int flags;
+      bool operator==( const Key& k ) const {
+	return flags == k.flags && lang == k.lang && word == k.word;
+      }
+    };
+    struct KeyHash {
+      size_t operator()( const Key& k ) const {
+	return k.word.hashCode() ^ ( k.lang << 4 ) ^ k.flags;
+      }
+    };
+    typedef std::list<std::pair<Key,Entry>> entry_list;
+    void trim( size_t );
+    entry_list entries; // the most recently used first
+    std::unordered_map<Key,entry_list::iterator,KeyHash> lookup;
+    size_t _capacity;
+    size_t _hits;
+    size_t _misses;
+  };
+
+  // the profiling data of one rule, see TokenizerClass::setRuleProfiling()
+  struct RuleProfile {
+    std::string language;
+    UnicodeString id;          // the rule, or NO_MATCH for the words
+                               // that no rule matched
+    size_t attempts = 0;       // the number of words it was tried on
+    size_t matches = 0;        // the number of matches
+    size_t skipped = 0;        // the number of words the prefilter skipped
+    uint64_t nanoseconds = 0;  // the time spent trying it
+    static const UnicodeString NO_MATCH;
+  };
+
+  // add the counts of the second list to those of the same language and
+  // rule in the first, f.e. to combine the profiles of several tokenizers
+  void add_rule_profile( std::vector<RuleProfile>&,
+			 const std::vector<RuleProfile>& );
+  // print a table of a list of profiles, the most expensive first
+  void print_rule_profile( std::ostream&, std::vector<RuleProfile> );
+
+  // the options of one call of TokenizerClass::tokenize( text, options )
+  struct TokenizeOptions {
+    std::string language;           // empty for the default language
+    bool sentence_per_line = false; // every line is a sentence
   };
 
   class TokenizerClass{
@@ -115,6 +206,9 @@ namespace Tokenizer {
     bool init( const std::vector<std::string>&,
 	       const std::string& ="" ); // init 1 or more languages
     bool initialize_textcat();
+    // forget the input seen so far: the tokens, the line number, the
+    // paragraph state and the quote stacks of ALL languages. The settings,
+    // the document ID and the word cache are kept
     bool reset( const std::string& = "default" );
     void setErrorLog( TiCC::LogStream *os );
     void setDebugLog( TiCC::LogStream *os );
@@ -140,6 +234,21 @@ namespace Tokenizer {
     //Tokenize from input stream to output stream
     void tokenize( std::istream&, std::ostream& );
 
+    // The same, but the input is cut at empty lines (paragraph boundaries)
+    // into chunks, which the helpers tokenize at the same time, each on
+    // its own thread. The helpers must be initialized just like this
+    // tokenizer. The output is the same as that of the previous one.
+    void tokenize( std::istream&, std::ostream&,
+		   const std::vector<TokenizerClass*>& );
+
+    // Tokenize a text, which may consist of several lines, into sentences.
+    // This doesn't touch the tokenizer at all: every call has its own
+    // state, so many threads may call it at the same time, as long as
+    // nobody changes the settings meanwhile. Every thread keeps that state
+    // for the next call, with the rule matchers and the word cache.
+    std::vector<std::vector<Token>> tokenize( const UnicodeString&,
+					      const TokenizeOptions& = TokenizeOptions() ) const;
+
     // Tokenize a line (a line is NOT just a sentence, but an arbitrary string
     //                  of characters, inclusive EOS markers, Newlines etc.)
     //
@@ -237,7 +346,9 @@ namespace Tokenizer {
 
     // set normalization mode
     std::string setNormalization( const std::string& s ) {
-      return normalizer.setMode( s );
+      std::string t = normalizer.setMode( s );
+      quick_normalizer = find_normalizer( normalizer.getMode() );
+      return t;
     }
     std::string getNormalization() const { return normalizer.getMode(); };
 
@@ -274,6 +385,22 @@ namespace Tokenizer {
     bool setUndLang( bool b ){ bool r = und_language; und_language = b; return r; };
     bool getUndLang(){ return und_language; };
 
+    // set the maximum number of words kept in the word cache. 0 disables it
+    size_t setWordCacheSize( size_t s ) { return word_cache.set_capacity( s ); }
+    size_t getWordCacheSize() const { return word_cache.capacity(); }
+    // the word cache, to inspect the hits() and misses()
+    const WordCache& getWordCache() const { return word_cache; }
+
+    // replace ill-formed UTF-8 by U+FFFD (the default), or skip the lines
+    // containing it. Either way, it is reported.
+    bool setReplaceInvalid( bool b=true ) { bool t = replace_invalid; replace_invalid = b; return t; }
+    bool getReplaceInvalid() const { return replace_invalid; }
+
+    // let tokenize( istream&, ostream& ) read and write on threads of
+    // their own, so waiting for I/O overlaps with tokenizing
+    bool setPipeline( bool b=true ) { bool t = pipeline; pipeline = b; return t; }
+    bool getPipeline() const { return pipeline; }
+
     bool setKeepQuotedSpaces( bool b ){ bool r = keep_quoted_spaces;
       keep_quoted_spaces = b; return r; };
     bool getKeepQuotedSpaces() const { return keep_quoted_spaces; };
@@ -298,6 +425,16 @@ namespace Tokenizer {
     const std::string& getDocID() const { return docid; }
     std::string setDocID( const std::string& );
 
+    // collect the number of attempts, matches and time spent per rule
+    bool setRuleProfiling( bool b=true ) { bool t = profile_rules; profile_rules = b; return t; }
+    bool getRuleProfiling() const { return profile_rules; }
+    // the profiling data of all rules, the most expensive first
+    std::vector<RuleProfile> getRuleProfile() const;
+    void printRuleProfile( std::ostream& ) const;
+
+    // store the compiled settings, to speed up the next init()
+    bool save_compiled_settings() const;
+
     bool get_setting_info( const std::string&,
 			   std::string&,
 			   std::string& ) const;
@@ -326,6 +463,15 @@ namespace Tokenizer {
 
     TokenizerClass( const TokenizerClass& ) = delete; // inhibit copies
     TokenizerClass& operator=( const TokenizerClass& ) = delete; // inhibit copies
+    // a session: a tokenizer with a state of its own, using the loaded
+    // configuration of another one
+    explicit TokenizerClass( const TokenizerClass * );
+    const TokenizerClass *config_owner; // 0 when the configuration is ours
+    // unique for every configuration, it changes with every init(). A
+    // session is only used again while it matches that of its owner
+    uint64_t config_serial;
+    // copy the options of the owner of a session, they may have changed
+    void use_options( const TokenizerClass& );
 
     void passthruLine( const UnicodeString&, bool& );
     void passthruLine( const std::string&, bool& );
@@ -348,18 +494,30 @@ namespace Tokenizer {
 
     //Processes tokens and initialises the sentence buffer. Returns the amount of sentences found
     int countSentences(bool forceentirebuffer = false);
+    void restart_scan();
+    void scan_changed( size_t );
+    void scan_popped( size_t );
     //count the number of sentences (only after detectSentenceBounds) (does some extra validation as well)
     int flushSentences( int, const std::string& = "default" );
     //Flush n sentences from buffer (does some extra validation as well)
 
     icu::UnicodeString outputTokens( const std::vector<Token>&,
 				     const bool=false ) const;
+    void outputTokens( OutputWriter&,
+		       const std::vector<Token>&,
+		       const bool=false ) const;
     void add_rule( const UnicodeString&,
 		   const std::vector<UnicodeString>& );
     void tokenizeWord( const UnicodeString&,
 		       bool,
-		       const std::string&,
+		       const Setting *,
+		       Symbol,
 		       const UnicodeString& ="" );
+    void tokenizeWordCached( const UnicodeString&,
+			     bool,
+			     const Setting *,
+			     Symbol,
+			     const UnicodeString& ="" );
     int internal_tokenize_line( const UnicodeString&,
 				const std::string& );
 
@@ -373,26 +531,96 @@ namespace Tokenizer {
     void detectQuotedSentenceBounds( const int offset,
 				     const std::string& = "default" );
     void detectQuoteBounds( const int,
-			    Quoting& );
+			    const Quoting&,
+			    QuoteStack& );
 
-    bool resolveQuote( int, const UnicodeString&, Quoting& );
+    bool resolveQuote( int,
+		       const UnicodeString&,
+		       const Quoting&,
+		       QuoteStack& );
     bool u_isquote( UChar32,
 		    const Quoting& ) const;
-    std::string checkBOM( std::istream& );
+    void open_input( std::istream& );
+    void report_invalid( const std::vector<uint64_t>& );
     void outputTokensDoc_init( folia::Document& ) const;
 
     void appendText( folia::FoliaElement * ) const;
 
     TiCC::UnicodeNormalizer normalizer;
+    // the ICU normalizer for the same mode, to find out cheaply that a
+    // line is normalized already. 0 when we don't know the mode
+    const icu::Normalizer2 *quick_normalizer;
+    static const icu::Normalizer2 *find_normalizer( const std::string& );
+    const UnicodeString& normalize_line( const UnicodeString& );
+    const UnicodeString& prepare_line( const UnicodeString&, const Setting * );
+    UnicodeString normalized_line; // see normalize_line()
+    UnicodeString prepared_line;   // see prepare_line()
     std::string inputEncoding;
+    // decodes the stream that tokenizeOneSentence() reads from
+    std::unique_ptr<InputDecoder> input_decoder;
+    bool replace_invalid;
+    bool pipeline;
+    bool next_line( UnicodeString& );
+    std::vector<Token> next_sentence( const std::string& = "" );
+    // a part of the input, taken at an empty line, and what it gives
+    struct Chunk {
+      std::vector<UnicodeString> lines;
+      std::string first;           // the first sentence
+      std::string first_continued; // the same, when not first in the output
+      std::string rest;            // all other sentences
+    };
+    bool read_chunk( std::vector<UnicodeString>& );
+    void tokenize_chunk( Chunk& );
+    // the lines next_line() takes, instead of reading input_decoder
+    const std::vector<UnicodeString> *chunk_lines;
+    size_t chunk_pos;
+    void tokenize_pipelined( std::istream&, std::ostream& );
+    // the lines next_line() takes when pipelined, from the reader thread
+    SPSCQueue<LineBlock> *line_queue;
+    LineBlock line_block; // the lines taken from line_queue
+    size_t block_pos;     // the next line in line_block
+    size_t bad_pos;       // the next entry in line_block.bad
 
     const UnicodeString& detect_type( UChar32 );
     bool is_separator( UChar32 );
     std::set<UChar32> separators;
     bool space_separated;
+    // the properties of every character. Sessions share it
+    std::shared_ptr<const CharTable> char_table;
+    bool keep_quoted_spaces;
+    void unmark_quoted_spaces( size_t );
 
     UnicodeString utt_mark;
-    std::vector<Token> tokens;
+    // the tokens waiting to be handed out. Sentences are taken from the
+    // front, so a deque avoids shifting all others every time
+    std::deque<Token> tokens;
+    // countSentences() remembers its state before every token it has seen,
+    // so a next call only has to look at the tokens that are new or have
+    // changed since.
+    struct ScanState {
+      short quotelevel;
+      size_t begin;   // first token of the current sentence, from scan_base
+      Symbol lang;
+      int count;      // completed sentences, from scan_base_count
+    };
+    std::deque<ScanState> scan_states; // the state before tokens[i]
+    ScanState scan_state;              // the state after the last one seen
+    size_t scan_base;        // the number of tokens popped
+    int scan_base_count;     // the sentence count at tokens[0]
+    size_t scan_dirty;       // the first token that must be seen again
+    // the first TEMPENDOFSENTENCE a forced count turns into ENDOFSENTENCE
+    size_t scan_pending;
+    // the quotes waiting for their counterpart, per Setting
+    std::map<const Setting*, QuoteStack> quote_stacks;
+    QuoteStack& quote_stack( const std::string& lang ){
+      return quote_stacks[get_setting( lang )]; };
+    // per Setting: a matcher for each of its rules, made when first used
+    std::map<const Setting*,
+	     std::vector<std::unique_ptr<RegexMatcher>>> rule_matchers;
+    WordCache word_cache;
+    bool profile_rules;
+    // per Setting: the profile of every rule, plus one for NO_MATCH
+    std::map<const Setting*, std::vector<RuleProfile>> rule_profile;
     std::set<UnicodeString> norm_set;
     TiCC::LogStream *theErrLog;
     TiCC::LogStream *theDbgLog;
@@ -400,7 +628,11 @@ namespace Tokenizer {
     bool und_language;
     std::string default_language;
     std::string document_language; // in case of an input FoLiA document
-    std::map<std::string,Setting*> settings;
+    // per language. Only the default one is read by init(), the others
+    // when they are first used. Shared with our sessions
+    std::map<std::string,std::shared_ptr<LazySetting>> settings;
+    // the Setting of a language, 0 when unknown or unreadable
+    const Setting *get_setting( const std::string& ) const;
     std::string _command; // original commandline
     //debug flag
     int tokDebug;
@@ -454,7 +686,8 @@ namespace Tokenizer {
     std::string inputclass; // class for folia text
     std::string outputclass; // class for folia text
     std::string data_version; // the version of uctodata
-    TextCat *text_cat;
+    TextCat *text_cat;   // only used when lang_id can't be
+    std::shared_ptr<const LanguageIdentifier> lang_id;
     folia::TextPolicy text_policy;
   };
 
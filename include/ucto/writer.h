@@ -0,0 +1,71 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+
+#ifndef UCTO_WRITER_H
+#define UCTO_WRITER_H
+
+#include <iostream>
+#include <string>
+#include "unicode/unistr.h"
+
+namespace Tokenizer {
+
+  // Collects UTF-8 output in one large buffer, which is reused, and
+  // writes it to a stream (when there is one) on flush_if_full() and
+  // flush(). Without a stream, everything is kept for str().
+  //
+  // UnicodeStrings are converted directly into the buffer, without
+  // temporary strings. Unpaired surrogates become U+FFFD, like ICU's
+  // toUTF8String() does it.
+  class OutputWriter {
+  public:
+    OutputWriter();
+    explicit OutputWriter( std::ostream& );
+    ~OutputWriter();
+    OutputWriter( const OutputWriter& ) = delete;
+    OutputWriter& operator=( const OutputWriter& ) = delete;
+    void put( char c ){ buffer += c; };
+    void put( const char *s ){ buffer += s; };
+    void put( const std::string& s ){ buffer += s; };
+    void put( const icu::UnicodeString& );
+    void put_lower( const icu::UnicodeString& );
+    void put_upper( const icu::UnicodeString& );
+    void flush();
+    bool full() const { return buffer.size() >= BUFFER_SIZE; };
+    void flush_if_full(){ if ( full() ) flush(); };
+    const std::string& str() const { return buffer; };
+    // hand out what is collected, and start afresh
+    std::string take(){ std::string s; s.swap( buffer ); return s; };
+  private:
+    static const size_t BUFFER_SIZE = 64*1024;
+    std::ostream *out;
+    std::string buffer;
+  };
+
+} // namespace Tokenizer
+
+#endif
@@ -0,0 +1,98 @@
+/*
+  Copyright (c) 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+#include <unistd.h>
+#include <pwd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include "ucto/cachefile.h"
+
+using namespace std;
+
+namespace Tokenizer {
+
+  string local_cache_dir(){
+    /// the directory for compiled files
+    /*!
+      \return $XDG_CACHE_HOME/ucto/ or, when that isn't set, ~/.cache/ucto/
+    */
+    const char *homedir = getenv("HOME") ? getenv("HOME") : getpwuid(getuid())->pw_dir; //never NULL
+    const char *xdgcachehome = getenv("XDG_CACHE_HOME"); //may be NULL
+    return ((xdgcachehome != NULL) ? string(xdgcachehome) : string(homedir) + "/.cache") + "/ucto/";
+  }
+
+  string full_path( const string& name ){
+    /// resolve a filename
+    /*!
+      \param name the name of a file
+      \return the absolute path, without symbolic links, or name when the
+      file doesn't exist
+    */
+    char *res = realpath( name.c_str(), 0 );
+    if ( !res ){
+      return name;
+    }
+    string result = res;
+    free( res );
+    return result;
+  }
+
+  MappedFile::~MappedFile(){
+    if ( data ){
+      munmap( const_cast<char*>( data ), size );
+    }
+  }
+
+  bool MappedFile::open( const string& name ){
+    /// map a file into memory
+    /*!
+      \param name the file
+      \return false when it is missing, empty or can't be mapped
+    */
+    int fd = ::open( name.c_str(), O_RDONLY );
+    if ( fd < 0 ){
+      return false;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0
+	 || st.st_size == 0 ){
+      close( fd );
+      return false;
+    }
+    void *buffer = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( buffer == MAP_FAILED ){
+      return false;
+    }
+    data = static_cast<const char*>( buffer );
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+  }
+
+} // namespace Tokenizer
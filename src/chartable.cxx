@@ -0,0 +1,302 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define UCTO_X86_SIMD 1
+#endif
+#include "unicode/uchar.h"
+#include "ucto/chartable.h"
+
+using namespace std;
+
+namespace Tokenizer {
+
+  namespace {
+
+    inline bool is_ascii_letter( UChar c ){
+      return (UChar)( ( c | 0x20 ) - 'a' ) < 26;
+    }
+
+    int32_t ascii_letters_scalar( const UChar *buf, int32_t len ){
+      int32_t i = 0;
+      while ( i < len && is_ascii_letter( buf[i] ) ){
+	++i;
+      }
+      return i;
+    }
+
+#ifdef UCTO_X86_SIMD
+    // x86-64 always has SSE2. The 16 bit code units are tested as signed
+    // numbers: (c|0x20)-'a' must be in [0,26). Anything above 0x7FFF turns
+    // negative and so fails as well.
+
+    int32_t ascii_letters_sse2( const UChar *buf, int32_t len ){
+      const __m128i lower = _mm_set1_epi16( 0x20 );
+      const __m128i a = _mm_set1_epi16( 'a' );
+      const __m128i below = _mm_set1_epi16( -1 );
+      const __m128i above = _mm_set1_epi16( 26 );
+      int32_t i = 0;
+      for ( ; i + 8 <= len; i += 8 ){
+	__m128i v = _mm_loadu_si128( (const __m128i*)( buf + i ) );
+	v = _mm_sub_epi16( _mm_or_si128( v, lower ), a );
+	const __m128i ok = _mm_and_si128( _mm_cmpgt_epi16( v, below ),
+					  _mm_cmplt_epi16( v, above ) );
+	const unsigned int mask = _mm_movemask_epi8( ok );
+	if ( mask != 0xFFFF ){
+	  return i + __builtin_ctz( ~mask ) / 2;
+	}
+      }
+      return i + ascii_letters_scalar( buf + i, len - i );
+    }
+
+    __attribute__((target("avx2")))
+    int32_t ascii_letters_avx2( const UChar *buf, int32_t len ){
+      const __m256i lower = _mm256_set1_epi16( 0x20 );
+      const __m256i a = _mm256_set1_epi16( 'a' );
+      const __m256i below = _mm256_set1_epi16( -1 );
+      const __m256i above = _mm256_set1_epi16( 26 );
+      int32_t i = 0;
+      for ( ; i + 16 <= len; i += 16 ){
+	__m256i v = _mm256_loadu_si256( (const __m256i*)( buf + i ) );
+	v = _mm256_sub_epi16( _mm256_or_si256( v, lower ), a );
+	const __m256i ok = _mm256_and_si256( _mm256_cmpgt_epi16( v, below ),
+					     _mm256_cmpgt_epi16( above, v ) );
+	const unsigned int mask = _mm256_movemask_epi8( ok );
+	if ( mask != 0xFFFFFFFF ){
+	  return i + __builtin_ctz( ~mask ) / 2;
+	}
+      }
+      return i + ascii_letters_sse2( buf + i, len - i );
+    }
+#endif
+
+    typedef int32_t (*letter_scanner)( const UChar *, int32_t );
+
+    letter_scanner select_scanner(){
+      // pick the best implementation for the CPU we run on
+#ifdef UCTO_X86_SIMD
+      __builtin_cpu_init();
+      if ( __builtin_cpu_supports( "avx2" ) ){
+	return ascii_letters_avx2;
+      }
+      return ascii_letters_sse2;
+#else
+      return ascii_letters_scalar;
+#endif
+    }
+
+  }
+
+  CharTable::Flags CharTable::compute( UChar32 c ){
+    /// ask ICU for the properties of a character
+    /*!
+      \param c the character
+      \return the Flags of c
+    */
+    Flags result = 0;
+    if ( u_isspace( c ) ){
+      result |= SEPARATOR;
+    }
+    if ( u_ispunct( c ) ){
+      result |= PUNCT;
+    }
+    if ( u_isdigit( c ) ){
+      result |= DIGIT;
+    }
+    if ( u_isalpha( c ) ){
+      result |= ALPHA;
+    }
+    if ( u_isupper( c ) || u_istitle( c ) ){
+      result |= UPPER;
+      UBlockCode s = ublock_getCode( c );
+      //test for languages that distinguish case
+      if ( (s == UBLOCK_BASIC_LATIN) || (s == UBLOCK_GREEK)
+	   || (s == UBLOCK_CYRILLIC) || (s == UBLOCK_GEORGIAN)
+	   || (s == UBLOCK_ARMENIAN) || (s == UBLOCK_DESERET)) {
+	result |= BOS;
+      }
+    }
+    if ( u_hasBinaryProperty( c, UCHAR_QUOTATION_MARK )
+	 || c == '`'
+	 || c == U'´' ) {
+      // M$ users use the spacing grave and acute accents often as a
+      // quote (apostroph) but is DOESN`T have the UCHAR_QUOTATION_MARK property
+      // so trick that
+      result |= QUOTE;
+    }
+    UBlockCode block = ublock_getCode( c );
+    if ( block == UBLOCK_EMOTICONS ){
+      result |= EMOTICON;
+    }
+    else if ( block == UBLOCK_MISCELLANEOUS_SYMBOLS_AND_PICTOGRAPHS ){
+      result |= PICTO;
+    }
+    switch ( u_charType( c ) ){
+    case U_OTHER_NUMBER:
+      result |= OTHER_NUMBER;
+      break;
+    case U_CURRENCY_SYMBOL:
+      result |= CURRENCY | SYMBOL;
+      break;
+    case U_MATH_SYMBOL:
+    case U_MODIFIER_SYMBOL:
+    case U_OTHER_SYMBOL:
+      result |= SYMBOL;
+      break;
+    case U_NON_SPACING_MARK:
+      result |= NONSPACING_MARK;
+      break;
+    default:
+      break;
+    }
+    if ( c == 0xfeff
+	 || c == 0xfffe
+	 || c == 0xefbbbf ){
+      result |= BOM;
+    }
+    return result;
+  }
+
+  CharTable::CharTable( bool ):
+    bmp( BMP_SIZE ),
+    removed( 0 ),
+    letter_flags( 0 )
+  {
+    /// build the table from scratch, only used for unicode()
+    for ( UChar32 c=0; c < BMP_SIZE; ++c ){
+      bmp[c] = compute( c );
+    }
+    collect_letter_flags();
+  }
+
+  const CharTable& CharTable::unicode(){
+    /// the table with the Unicode properties of all characters
+    /*!
+      \return a table which is built only once, on first use
+    */
+    static const CharTable table( true );
+    return table;
+  }
+
+  CharTable::CharTable():
+    bmp( unicode().bmp ),
+    removed( 0 ),
+    letter_flags( unicode().letter_flags )
+  {
+    /// create a table with the Unicode properties, ready to be extended
+  }
+
+  CharTable::Flags CharTable::supplementary( UChar32 c ) const {
+    /// the flags of a character outside the BMP
+    /*!
+      \param c the character
+      \return the Flags of c
+    */
+    Flags result = compute( c ) & ~removed;
+    if ( !added.empty() ){
+      auto it = added.find( c );
+      if ( it != added.end() ){
+	result |= it->second;
+      }
+    }
+    return result;
+  }
+
+  void CharTable::add( UChar32 c, Flags f ){
+    /// add flags to a character
+    /*!
+      \param c the character
+      \param f the Flags to add
+    */
+    if ( c >= 0 && c < BMP_SIZE ){
+      bmp[c] |= f;
+      if ( is_ascii_letter( c ) ){
+	letter_flags |= f;
+      }
+    }
+    else {
+      added[c] |= f;
+    }
+  }
+
+  void CharTable::remove( Flags f ){
+    /// remove flags from ALL characters
+    /*!
+      \param f the Flags to remove
+    */
+    for ( auto& flags : bmp ){
+      flags &= ~f;
+    }
+    for ( auto& it : added ){
+      it.second &= ~f;
+    }
+    removed |= f;
+    letter_flags &= ~f;
+  }
+
+  void CharTable::reset( Flags f ){
+    /// give flags their Unicode value again, for ALL characters
+    /*!
+      \param f the Flags to reset
+    */
+    const vector<Flags>& orig = unicode().bmp;
+    for ( UChar32 c=0; c < BMP_SIZE; ++c ){
+      bmp[c] = ( bmp[c] & ~f ) | ( orig[c] & f );
+    }
+    for ( auto& it : added ){
+      it.second &= ~f;
+    }
+    removed &= ~f;
+    collect_letter_flags();
+  }
+
+  void CharTable::collect_letter_flags(){
+    /// combine the flags of all ASCII letters, for plain_letters()
+    letter_flags = 0;
+    for ( UChar32 c = 'A'; c <= 'z'; ++c ){
+      if ( is_ascii_letter( c ) ){
+	letter_flags |= bmp[c];
+      }
+    }
+  }
+
+  int32_t CharTable::ascii_letters( const UChar *buf, int32_t len ){
+    /// count the ASCII letters at the start of a buffer
+    /*!
+      \param buf the UTF-16 buffer
+      \param len the number of code units available in buf
+      \return the number of code units before the first one that isn't
+      an ASCII letter (a-z, A-Z), or len
+
+      On x86-64 this uses AVX2 when the CPU has it, and SSE2 otherwise.
+    */
+    static const letter_scanner scan = select_scanner();
+    return scan( buf, len );
+  }
+
+} // namespace Tokenizer
@@ -0,0 +1,354 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define UCTO_X86_SIMD 1
+#endif
+#include "unicode/utf8.h"
+#include "unicode/utf16.h"
+#include "ucto/decoder.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Tokenizer {
+
+  namespace {
+
+    // Copy the ASCII bytes at the start of a buffer to UTF-16. Returns the
+    // number of them. The vector versions may write some more code units
+    // after those, which is harmless as out has room for len of them, and
+    // the caller overwrites them anyway.
+
+    size_t widen_ascii_scalar( const uint8_t *s, size_t len, UChar *out ){
+      size_t i = 0;
+      while ( i < len && s[i] < 0x80 ){
+	out[i] = s[i];
+	++i;
+      }
+      return i;
+    }
+
+#ifdef UCTO_X86_SIMD
+    // x86-64 always has SSE2. A byte that isn't ASCII has its top bit set,
+    // which is just what movemask collects.
+
+    size_t widen_ascii_sse2( const uint8_t *s, size_t len, UChar *out ){
+      const __m128i zero = _mm_setzero_si128();
+      size_t i = 0;
+      for ( ; i + 16 <= len; i += 16 ){
+	const __m128i v = _mm_loadu_si128( (const __m128i*)( s + i ) );
+	_mm_storeu_si128( (__m128i*)( out + i ), _mm_unpacklo_epi8( v, zero ) );
+	_mm_storeu_si128( (__m128i*)( out + i + 8 ),
+			  _mm_unpackhi_epi8( v, zero ) );
+	const unsigned int mask = _mm_movemask_epi8( v );
+	if ( mask != 0 ){
+	  return i + __builtin_ctz( mask );
+	}
+      }
+      return i + widen_ascii_scalar( s + i, len - i, out + i );
+    }
+
+    __attribute__((target("avx2")))
+    size_t widen_ascii_avx2( const uint8_t *s, size_t len, UChar *out ){
+      size_t i = 0;
+      for ( ; i + 32 <= len; i += 32 ){
+	const __m256i v = _mm256_loadu_si256( (const __m256i*)( s + i ) );
+	_mm256_storeu_si256( (__m256i*)( out + i ),
+			     _mm256_cvtepu8_epi16( _mm256_castsi256_si128( v ) ) );
+	_mm256_storeu_si256( (__m256i*)( out + i + 16 ),
+			     _mm256_cvtepu8_epi16( _mm256_extracti128_si256( v, 1 ) ) );
+	const unsigned int mask = _mm256_movemask_epi8( v );
+	if ( mask != 0 ){
+	  return i + __builtin_ctz( mask );
+	}
+      }
+      return i + widen_ascii_sse2( s + i, len - i, out + i );
+    }
+#endif
+
+    typedef size_t (*ascii_widener)( const uint8_t *, size_t, UChar * );
+
+    ascii_widener select_widener(){
+      // pick the best implementation for the CPU we run on
+#ifdef UCTO_X86_SIMD
+      __builtin_cpu_init();
+      if ( __builtin_cpu_supports( "avx2" ) ){
+	return widen_ascii_avx2;
+      }
+      return widen_ascii_sse2;
+#else
+      return widen_ascii_scalar;
+#endif
+    }
+
+  }
+
+  InputDecoder::InputDecoder( istream& is, const string& enc ):
+    in( is ),
+    _encoding( enc ),
+    converter( 0 ),
+    bytes( BLOCK_SIZE ),
+    bytes_used( 0 ),
+    offset( 0 ),
+    chars( BLOCK_SIZE ),
+    pos( 0 ),
+    at_end( false )
+  {
+    /// start decoding a stream
+    /*!
+      \param is the stream to read from
+      \param enc the encoding of the stream, unless it starts with a BOM
+    */
+    in.read( bytes.data(), BLOCK_SIZE );
+    bytes.resize( in.gcount() );
+    UErrorCode err = U_ZERO_ERROR;
+    int32_t bomLength = 0;
+    const char *detected = ucnv_detectUnicodeSignature( bytes.data(),
+							 bytes.size(),
+							 &bomLength,
+							 &err );
+    if ( U_SUCCESS( err ) && bomLength > 0 ){
+      _encoding = detected;
+      bytes_used = bomLength;
+    }
+    if ( ucnv_compareNames( _encoding.c_str(), "UTF-8" ) == 0 ){
+      // we decode UTF-8 ourselves
+      return;
+    }
+    err = U_ZERO_ERROR;
+    converter = ucnv_open( _encoding.c_str(), &err );
+    if ( U_FAILURE( err ) ){
+      throw uCodingError( "string decoding failed: (invalid inputEncoding '"
+			  + _encoding + "' ?)" );
+    }
+  }
+
+  InputDecoder::~InputDecoder(){
+    if ( converter ){
+      ucnv_close( converter );
+    }
+  }
+
+  size_t InputDecoder::decode_utf8( const char *buf, size_t len,
+				    uint64_t buf_offset, bool last ){
+    /// decode UTF-8 to the end of decoded, without an ICU converter
+    /*!
+      \param buf the bytes to decode
+      \param len the number of bytes
+      \param buf_offset the offset of buf in the stream
+      \param last true when there is nothing after buf
+      \return the number of bytes used. A character that is incomplete at
+      the end of buf is left for the next block, unless buf is the last
+
+      Most input is mainly ASCII, which is copied 16 or 32 bytes at a
+      time (using SSE2 or AVX2, whatever the CPU has). The other characters
+      are checked and decoded one by one. An ill-formed sequence becomes
+      one U+FFFD, just like the ICU converter does it, and its offset is
+      kept for bad_sequences().
+    */
+    static const ascii_widener widen_ascii = select_widener();
+    const uint8_t *s = reinterpret_cast<const uint8_t*>( buf );
+    int32_t length = len;
+    if ( !last ){
+      for ( int32_t back = 1; back <= 3 && back <= length; ++back ){
+	const uint8_t b = s[length-back];
+	if ( U8_IS_LEAD( b ) ){
+	  if ( U8_COUNT_TRAIL_BYTES( b ) >= back ){
+	    length -= back;
+	  }
+	  break;
+	}
+	if ( !U8_IS_TRAIL( b ) ){
+	  break;
+	}
+      }
+    }
+    // every byte gives at most one UChar
+    int32_t n = decoded.length();
+    UChar *out = decoded.getBuffer( n + length );
+    int32_t i = 0;
+    while ( i < length ){
+      const int32_t ascii = widen_ascii( s + i, length - i, out + n );
+      i += ascii;
+      n += ascii;
+      while ( i < length && s[i] >= 0x80 ){
+	const int32_t start = i;
+	UChar32 c;
+	U8_NEXT( s, i, length, c );
+	if ( c < 0 ){
+	  pending_bad.push_back( { n, buf_offset + start } );
+	  out[n++] = 0xFFFD;
+	}
+	else {
+	  U16_APPEND_UNSAFE( out, n, c );
+	}
+      }
+    }
+    decoded.releaseBuffer( n );
+    return length;
+  }
+
+  bool InputDecoder::fill(){
+    /// decode the next block of the stream
+    /*!
+      \return false when the whole stream is decoded already
+
+      The lines already handed out are removed from the decoded text.
+      A character that is split over two blocks is kept (in the
+      converter, or in bytes for UTF-8) until the next block completes it.
+    */
+    if ( at_end ){
+      return false;
+    }
+    if ( in ){
+      // keep what is left (the start of a character) in front of the
+      // new block
+      bytes.erase( bytes.begin(), bytes.begin() + bytes_used );
+      offset += bytes_used;
+      const size_t kept = bytes.size();
+      bytes.resize( kept + BLOCK_SIZE );
+      in.read( bytes.data() + kept, BLOCK_SIZE );
+      bytes.resize( kept + in.gcount() );
+      bytes_used = 0;
+    }
+    const bool last = !in;
+    decoded.remove( 0, pos );
+    for ( auto& bad : pending_bad ){
+      bad.at -= pos;
+    }
+    pos = 0;
+    if ( !converter ){
+      bytes_used += decode_utf8( bytes.data() + bytes_used,
+				 bytes.size() - bytes_used,
+				 offset + bytes_used,
+				 last );
+      at_end = last;
+      return true;
+    }
+    const char *source = bytes.data() + bytes_used;
+    const char *source_end = bytes.data() + bytes.size();
+    UErrorCode err;
+    do {
+      err = U_ZERO_ERROR;
+      UChar *target = chars.data();
+      ucnv_toUnicode( converter,
+		      &target, chars.data() + chars.size(),
+		      &source, source_end,
+		      NULL, last, &err );
+      decoded.append( chars.data(), target - chars.data() );
+    } while ( err == U_BUFFER_OVERFLOW_ERROR );
+    if ( U_FAILURE( err ) ){
+      throw uCodingError( string( "Unexpected character found in input. " )
+			  + u_errorName( err )
+			  + "Make sure input is valid: " + _encoding );
+    }
+    bytes_used = bytes.size();
+    at_end = last;
+    return true;
+  }
+
+  void InputDecoder::take_bad( int32_t end ){
+    /// collect the ill-formed sequences of the line that is handed out
+    /*!
+      \param end the end of the line in decoded
+    */
+    while ( !pending_bad.empty()
+	    && pending_bad.front().at < end ){
+      line_bad.push_back( pending_bad.front().offset );
+      pending_bad.pop_front();
+    }
+  }
+
+  bool InputDecoder::getline( UnicodeString& line ){
+    /// get the next line of the input
+    /*!
+      \param line the line found, without the line end (LF or CR LF)
+      \return false when there are no more lines
+    */
+    line_bad.clear();
+    int32_t from = pos;
+    while ( true ){
+      const int32_t nl = decoded.indexOf( (UChar)'\n', from );
+      if ( nl >= 0 ){
+	int32_t end = nl;
+	if ( end > pos && decoded[end-1] == '\r' ){
+	  --end;
+	}
+	line.setTo( decoded, pos, end - pos );
+	pos = nl + 1;
+	take_bad( pos );
+	return true;
+      }
+      // no line end yet. Don't search the same part again
+      const int32_t seen = decoded.length() - pos;
+      if ( !fill() ){
+	break;
+      }
+      from = seen;
+    }
+    if ( pos < decoded.length() ){
+      // the last line has no line end
+      int32_t end = decoded.length();
+      if ( decoded[end-1] == '\r' ){
+	--end;
+      }
+      line.setTo( decoded, pos, end - pos );
+      pos = decoded.length();
+      take_bad( pos );
+      return true;
+    }
+    line.remove();
+    return false;
+  }
+
+  bool InputDecoder::getlines( LineBlock& block, size_t size ){
+    /// get the next lines of the input
+    /*!
+      \param block the lines found. What was in it is thrown away
+      \param size the number of characters after which we stop
+      \return false when there are no more lines
+    */
+    block.lines.clear();
+    block.bad.clear();
+    size_t chars = 0;
+    while ( chars < size ){
+      block.lines.emplace_back();
+      if ( !getline( block.lines.back() ) ){
+	block.lines.pop_back();
+	break;
+      }
+      if ( !line_bad.empty() ){
+	block.bad.push_back( make_pair( block.lines.size() - 1, line_bad ) );
+      }
+      chars += block.lines.back().length() + 1;
+    }
+    return !block.lines.empty();
+  }
+
+} // namespace Tokenizer
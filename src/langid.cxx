@@ -0,0 +1,574 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include "unicode/uchar.h"
+#include "unicode/utf8.h"
+#include "ticcutils/StringOps.h"
+#include "ticcutils/FileUtils.h"
+#include "ucto/cachefile.h"
+#include "ucto/langid.h"
+
+using namespace std;
+using namespace icu;
+
+#define LOG *TiCC::Log(log)
+#define DBG *TiCC::Log(dbg)
+
+namespace Tokenizer {
+
+  namespace {
+
+    // the values TextCat uses
+    const size_t MAX_NGRAMS = 400;        // the size of a fingerprint
+    const size_t MAX_NGRAM_SIZE = 5;
+    const int32_t MAX_OUT_OF_PLACE = 400;
+    const int32_t MIN_DOCUMENT_SIZE = 25;
+    const double THRESHOLD = 1.03;
+    const size_t MAX_CANDIDATES = 5;
+
+    // the rank of an n-gram a language doesn't have. It is more than
+    // MAX_OUT_OF_PLACE away from every real rank.
+    const int32_t ABSENT = 2 * MAX_OUT_OF_PLACE;
+
+    // the rows of ranks are padded to a multiple of this
+    const size_t LANES = 8;
+
+    // the layout of a compiled fingerprints file. Increment FORMAT_VERSION
+    // whenever it changes.
+    //   MAGIC, FORMAT_VERSION, ENDIAN_MARK
+    //   the length of the name of the textcat.cfg, the name, padded to 8
+    //   the number of languages, 0
+    //   per language: its code in CODE_SIZE bytes, the number of n-grams
+    //   all n-gram hashes, language after language
+    // Everything is 8 byte aligned, so the hashes can be used in place.
+    const char MAGIC[8] = { 'U', 'C', 'T', 'O', 'L', 'I', 'D', '\0' };
+    const uint32_t FORMAT_VERSION = 1;
+    const uint32_t ENDIAN_MARK = 0x01020304;
+    const size_t CODE_SIZE = 16;
+
+    const uint64_t HASH_START = 14695981039346656037ULL;
+
+    inline uint64_t add_char( uint64_t hash, UChar32 c ){
+      // FNV-1a, on whole characters, so UTF-8 and UTF-16 agree
+      hash ^= static_cast<uint32_t>( c );
+      hash *= 1099511628211ULL;
+      return hash;
+    }
+
+    inline uint64_t final_hash( uint64_t hash ){
+      // 0 marks a free slot in the table
+      return hash ? hash : 1;
+    }
+
+    inline size_t slot_of( uint64_t key, size_t mask ){
+      return ( key ^ ( key >> 29 ) ) & mask;
+    }
+
+    inline bool separates( UChar32 c ){
+      // like TextCat, only spaces and digits separate 'words'
+      if ( c < 0x80 ){
+	// what u_isspace() and u_isdigit() say, but faster
+	return c == ' '
+	  || ( c >= '\t' && c <= '\r' )
+	  || ( c >= 0x1C && c <= 0x1F )
+	  || ( c >= '0' && c <= '9' );
+      }
+      return u_isspace( c ) || u_isdigit( c );
+    }
+
+    uint64_t hash_ngram( const string& ngram ){
+      // fingerprints are UTF-8 (libexttextcat) or Latin-1 (older ones)
+      const uint8_t *s = reinterpret_cast<const uint8_t*>( ngram.data() );
+      const int32_t len = ngram.size();
+      uint64_t hash = HASH_START;
+      int32_t i = 0;
+      while ( i < len ){
+	UChar32 c;
+	U8_NEXT( s, i, len, c );
+	if ( c < 0 ){
+	  hash = HASH_START;
+	  for ( int32_t j=0; j < len; ++j ){
+	    hash = add_char( hash, s[j] );
+	  }
+	  break;
+	}
+	hash = add_char( hash, c );
+      }
+      return final_hash( hash );
+    }
+
+    vector<pair<string,string>> read_config( const string& cfg ){
+      // the fingerprint files in a textcat.cfg, with their language
+      vector<pair<string,string>> result;
+      ifstream is( cfg );
+      if ( !is ){
+	throw runtime_error( "unable to open: " + cfg );
+      }
+      string line;
+      while ( getline( is, line ) ){
+	line = TiCC::trim( line );
+	if ( line.empty() || line[0] == '#' ){
+	  continue;
+	}
+	vector<string> parts = TiCC::split( line );
+	if ( parts.size() < 2 ){
+	  continue;
+	}
+	bool known = false;
+	for ( const auto& it : result ){
+	  if ( it.second == parts[1] ){
+	    known = true;
+	    break;
+	  }
+	}
+	if ( !known ){
+	  // TextCat would never choose a second one either
+	  result.push_back( make_pair( parts[0], parts[1] ) );
+	}
+      }
+      return result;
+    }
+
+    vector<uint64_t> read_fingerprint( const string& file ){
+      // the hashes of the n-grams in a .lm file, the most frequent first
+      ifstream is( file, ios::binary );
+      if ( !is ){
+	throw runtime_error( "unable to open fingerprint: " + file );
+      }
+      vector<uint64_t> result;
+      string line;
+      while ( result.size() < MAX_NGRAMS
+	      && getline( is, line ) ){
+	const string ngram = line.substr( 0, line.find_first_of( " \t\r" ) );
+	if ( !ngram.empty() ){
+	  result.push_back( hash_ngram( ngram ) );
+	}
+      }
+      return result;
+    }
+
+    size_t padded( size_t len ){
+      return ( len + 7 ) & ~size_t(7);
+    }
+
+    template <class T>
+    T read_at( const MappedFile& file, size_t& pos ){
+      T v;
+      if ( sizeof(T) > file.size - pos ){
+	throw runtime_error( "truncated" );
+      }
+      memcpy( &v, file.data + pos, sizeof(T) );
+      pos += sizeof(T);
+      return v;
+    }
+
+    bool use_compiled( const MappedFile& file,
+		       const string& cfg,
+		       const vector<pair<string,string>>& config,
+		       const vector<string>& wanted,
+		       vector<string>& codes,
+		       vector<pair<const uint64_t*,size_t>>& fingerprints,
+		       string& reason ){
+      // find the wanted fingerprints in a compiled file, without copying
+      try {
+	size_t pos = 0;
+	char magic[sizeof(MAGIC)];
+	for ( auto& c : magic ){
+	  c = read_at<char>( file, pos );
+	}
+	if ( memcmp( magic, MAGIC, sizeof(MAGIC) ) != 0
+	     || read_at<uint32_t>( file, pos ) != FORMAT_VERSION
+	     || read_at<uint32_t>( file, pos ) != ENDIAN_MARK ){
+	  throw runtime_error( "wrong format or version" );
+	}
+	const uint32_t name_len = read_at<uint32_t>( file, pos );
+	if ( name_len > file.size - pos ){
+	  throw runtime_error( "truncated" );
+	}
+	if ( string( file.data + pos, name_len ) != full_path( cfg ) ){
+	  throw runtime_error( "compiled from another textcat.cfg" );
+	}
+	pos = padded( pos + name_len );
+	struct stat src;
+	if ( stat( cfg.c_str(), &src ) != 0
+	     || src.st_mtime >= file.mtime ){
+	  throw runtime_error( "outdated by " + cfg );
+	}
+	for ( const auto& it : config ){
+	  if ( stat( it.first.c_str(), &src ) != 0
+	       || src.st_mtime >= file.mtime ){
+	    throw runtime_error( "outdated by " + it.first );
+	  }
+	}
+	const uint32_t languages = read_at<uint32_t>( file, pos );
+	read_at<uint32_t>( file, pos );
+	if ( languages > ( file.size - pos ) / ( CODE_SIZE + 8 ) ){
+	  throw runtime_error( "invalid count" );
+	}
+	size_t hashes = pos + languages * ( CODE_SIZE + 8 );
+	for ( uint32_t i=0; i < languages; ++i ){
+	  char code[CODE_SIZE];
+	  for ( auto& c : code ){
+	    c = read_at<char>( file, pos );
+	  }
+	  code[CODE_SIZE-1] = '\0';
+	  const uint64_t count = read_at<uint64_t>( file, pos );
+	  if ( count > ( file.size - hashes ) / sizeof(uint64_t) ){
+	    throw runtime_error( "truncated" );
+	  }
+	  if ( wanted.empty()
+	       || find( wanted.begin(), wanted.end(), code ) != wanted.end() ){
+	    codes.push_back( code );
+	    fingerprints.push_back( make_pair( reinterpret_cast<const uint64_t*>( file.data + hashes ), count ) );
+	  }
+	  hashes += count * sizeof(uint64_t);
+	}
+	if ( hashes != file.size ){
+	  throw runtime_error( "trailing garbage" );
+	}
+      }
+      catch ( const exception& e ){
+	reason = e.what();
+	codes.clear();
+	fingerprints.clear();
+	return false;
+      }
+      return true;
+    }
+
+  }
+
+  LanguageIdentifier::LanguageIdentifier( const string& cfg,
+					  const vector<string>& wanted,
+					  TiCC::LogStream *log,
+					  TiCC::LogStream *dbg ):
+    cfg_name( cfg ),
+    width( 0 ),
+    compiled( false )
+  {
+    /// set up language guessing for some languages
+    /*!
+      \param cfg the textcat.cfg that lists the fingerprints
+      \param wanted the languages to consider. All languages in cfg when
+      empty
+      \param log a stream for messages, if any
+      \param dbg a stream for debugging messages, if any
+
+      The fingerprints are taken from the compiled file when it is up to
+      date, otherwise from the .lm files. Languages without a fingerprint
+      are left out. When none remain, isInit() is false.
+    */
+    const vector<pair<string,string>> config = read_config( cfg );
+    vector<string> found;
+    vector<pair<const uint64_t*,size_t>> fingerprints;
+    MappedFile file;
+    string reason;
+    if ( file.open( compiled_name( cfg ) )
+	 && use_compiled( file, cfg, config, wanted,
+			  found, fingerprints, reason ) ){
+      compiled = true;
+    }
+    else if ( !reason.empty() && dbg ){
+      DBG << "not using compiled fingerprints " << compiled_name( cfg )
+	  << ": " << reason << endl;
+    }
+    vector<vector<uint64_t>> from_lm( config.size() );
+    if ( !compiled ){
+      for ( size_t i=0; i < config.size(); ++i ){
+	const string& code = config[i].second;
+	if ( !wanted.empty()
+	     && find( wanted.begin(), wanted.end(), code ) == wanted.end() ){
+	  continue;
+	}
+	try {
+	  from_lm[i] = read_fingerprint( config[i].first );
+	}
+	catch ( const exception& e ){
+	  if ( log ){
+	    LOG << e.what() << endl;
+	  }
+	  continue;
+	}
+	found.push_back( code );
+	fingerprints.push_back( make_pair( from_lm[i].data(), from_lm[i].size() ) );
+      }
+    }
+    // the table holds a row for every n-gram of the fingerprints, with the
+    // rank in all languages. Rows are padded, so the additions in
+    // get_language() can always be done in full vectors.
+    codes = found;
+    width = ( codes.size() + LANES - 1 ) / LANES * LANES;
+    size_t total = 0;
+    for ( const auto& fp : fingerprints ){
+      total += fp.second;
+    }
+    size_t slots = 16;
+    while ( slots < 2 * total ){
+      slots *= 2;
+    }
+    keys.assign( slots, 0 );
+    rows.assign( slots, -1 );
+    const size_t mask = slots - 1;
+    for ( size_t lang=0; lang < fingerprints.size(); ++lang ){
+      const uint64_t *ngrams = fingerprints[lang].first;
+      for ( size_t rank=0; rank < fingerprints[lang].second; ++rank ){
+	const uint64_t key = ngrams[rank];
+	size_t slot = slot_of( key, mask );
+	while ( keys[slot] != 0 && keys[slot] != key ){
+	  slot = ( slot + 1 ) & mask;
+	}
+	if ( keys[slot] == 0 ){
+	  keys[slot] = key;
+	  rows[slot] = ranks.size() / width;
+	  ranks.resize( ranks.size() + width, ABSENT );
+	}
+	int32_t& r = ranks[rows[slot] * width + lang];
+	r = min( r, int32_t(rank) );
+      }
+    }
+  }
+
+  int32_t LanguageIdentifier::find_row( uint64_t key ) const {
+    /// the row of ranks of an n-gram
+    /*!
+      \param key the hash of the n-gram
+      \return the row, -1 when no language has the n-gram
+    */
+    const size_t mask = keys.size() - 1;
+    size_t slot = slot_of( key, mask );
+    while ( keys[slot] != 0 ){
+      if ( keys[slot] == key ){
+	return rows[slot];
+      }
+      slot = ( slot + 1 ) & mask;
+    }
+    return -1;
+  }
+
+  string LanguageIdentifier::get_language( const UnicodeString& text ) const {
+    /// guess the language of a text
+    /*!
+      \param text the text, lowercased, just like TextCat wants it
+      \return the most likely language, or "" when the text is too short,
+      or too many languages are about equally likely
+    */
+    if ( codes.empty()
+	 || text.length() < MIN_DOCUMENT_SIZE ){
+      return "";
+    }
+    // the words, each between '_'
+    vector<UChar32> chars;
+    chars.reserve( text.length() + 2 );
+    chars.push_back( '_' );
+    for ( int32_t i=0; i < text.length(); ){
+      const UChar32 c = text.char32At( i );
+      i += U16_LENGTH( c );
+      if ( !separates( c ) ){
+	chars.push_back( c );
+      }
+      else if ( chars.back() != '_' ){
+	chars.push_back( '_' );
+      }
+    }
+    if ( chars.back() != '_' ){
+      chars.push_back( '_' );
+    }
+    // count the n-grams, in a flat hash table as well. They may only have
+    // a '_' at their ends
+    size_t slots = 64;
+    while ( slots < 2 * MAX_NGRAM_SIZE * chars.size() ){
+      slots *= 2;
+    }
+    const size_t mask = slots - 1;
+    vector<uint64_t> hashes( slots, 0 );
+    vector<uint32_t> counts( slots, 0 );
+    vector<uint32_t> seen; // the used slots, in order of appearance
+    seen.reserve( MAX_NGRAM_SIZE * chars.size() );
+    uint32_t max_count = 0;
+    for ( size_t i=0; i < chars.size(); ++i ){
+      uint64_t hash = HASH_START;
+      for ( size_t n=0; n < MAX_NGRAM_SIZE && i + n < chars.size(); ++n ){
+	hash = add_char( hash, chars[i+n] );
+	const uint64_t key = final_hash( hash );
+	size_t slot = slot_of( key, mask );
+	while ( hashes[slot] != 0 && hashes[slot] != key ){
+	  slot = ( slot + 1 ) & mask;
+	}
+	if ( hashes[slot] == 0 ){
+	  hashes[slot] = key;
+	  seen.push_back( slot );
+	}
+	max_count = max( max_count, ++counts[slot] );
+	if ( n > 0 && chars[i+n] == '_' ){
+	  break;
+	}
+      }
+    }
+    // our fingerprint: the most frequent first, equally frequent ones in
+    // order of appearance. Counts are small, so a counting sort will do
+    vector<uint32_t> first( max_count + 1, 0 );
+    for ( const auto slot : seen ){
+      ++first[max_count - counts[slot]];
+    }
+    uint32_t total = 0;
+    for ( auto& f : first ){
+      const uint32_t n = f;
+      f = total;
+      total += n;
+    }
+    vector<uint64_t> ngrams( seen.size() );
+    for ( const auto slot : seen ){
+      ngrams[first[max_count - counts[slot]]++] = hashes[slot];
+    }
+    const size_t size = min( ngrams.size(), MAX_NGRAMS );
+    // the out-of-place distance to every language
+    vector<int32_t> distance( width, 0 );
+    int32_t unknown = 0;
+    for ( size_t rank=0; rank < size; ++rank ){
+      const int32_t row = find_row( ngrams[rank] );
+      if ( row < 0 ){
+	++unknown;
+	continue;
+      }
+      const int32_t *lang_ranks = &ranks[row * width];
+      // no branches, and whole rows: the compiler vectorizes this
+      for ( size_t lang=0; lang < width; ++lang ){
+	distance[lang] += min( abs( int32_t(rank) - lang_ranks[lang] ),
+			       MAX_OUT_OF_PLACE );
+      }
+    }
+    size_t best = 0;
+    for ( size_t lang=1; lang < codes.size(); ++lang ){
+      if ( distance[lang] < distance[best] ){
+	best = lang;
+      }
+    }
+    // like TextCat, give up when too many languages come close
+    const double limit = THRESHOLD
+      * ( distance[best] + unknown * MAX_OUT_OF_PLACE );
+    size_t candidates = 0;
+    for ( size_t lang=0; lang < codes.size(); ++lang ){
+      if ( distance[lang] + unknown * MAX_OUT_OF_PLACE <= limit ){
+	++candidates;
+      }
+    }
+    if ( candidates > MAX_CANDIDATES ){
+      return "";
+    }
+    return codes[best];
+  }
+
+  string LanguageIdentifier::compiled_name( const string& cfg ){
+    /// the name of the compiled fingerprints of a textcat.cfg
+    /*!
+      \param cfg the textcat.cfg
+      \return the name of the compiled file, in the local cachedir
+    */
+    return local_cache_dir() + TiCC::basename( cfg ) + ".bin";
+  }
+
+  bool LanguageIdentifier::save_compiled( const string& cfg,
+					  TiCC::LogStream *log ){
+    /// store the hashed fingerprints of all languages of a textcat.cfg
+    /*!
+      \param cfg the textcat.cfg
+      \param log a stream for messages, if any
+      \return true on succes
+
+      The file is written under a temporary name first and then renamed,
+      so other processes never see a partial file.
+    */
+    vector<pair<string,vector<uint64_t>>> fingerprints;
+    try {
+      for ( const auto& it : read_config( cfg ) ){
+	if ( it.second.size() >= CODE_SIZE ){
+	  throw runtime_error( "language code too long: " + it.second );
+	}
+	fingerprints.push_back( make_pair( it.second,
+					   read_fingerprint( it.first ) ) );
+      }
+    }
+    catch ( const exception& e ){
+      if ( log ){
+	LOG << e.what() << endl;
+      }
+      return false;
+    }
+    const string fname = compiled_name( cfg );
+    if ( !TiCC::createPath( TiCC::dirname( fname ) + "/" ) ){
+      return false;
+    }
+    string tmp_name = fname + "." + to_string( getpid() );
+    ofstream os( tmp_name, ios::binary );
+    if ( !os ){
+      return false;
+    }
+    auto u32 = [&]( uint32_t v ){
+      os.write( reinterpret_cast<const char*>( &v ), sizeof(v) );
+    };
+    auto u64 = [&]( uint64_t v ){
+      os.write( reinterpret_cast<const char*>( &v ), sizeof(v) );
+    };
+    os.write( MAGIC, sizeof(MAGIC) );
+    u32( FORMAT_VERSION );
+    u32( ENDIAN_MARK );
+    const string name = full_path( cfg );
+    u32( name.size() );
+    os << name;
+    const size_t pos = sizeof(MAGIC) + 3 * sizeof(uint32_t) + name.size();
+    os << string( padded( pos ) - pos, '\0' );
+    u32( fingerprints.size() );
+    u32( 0 );
+    for ( const auto& fp : fingerprints ){
+      string code = fp.first;
+      code.resize( CODE_SIZE, '\0' );
+      os << code;
+      u64( fp.second.size() );
+    }
+    for ( const auto& fp : fingerprints ){
+      for ( const auto& hash : fp.second ){
+	u64( hash );
+      }
+    }
+    os.close();
+    if ( !os
+	 || rename( tmp_name.c_str(), fname.c_str() ) != 0 ){
+      remove( tmp_name.c_str() );
+      return false;
+    }
+    return true;
+  }
+
+} // namespace Tokenizer
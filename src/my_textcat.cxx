@@ -81,6 +81,7 @@ vector<string> TextCat::get_languages( const string& in ) const {
     DBG << "textcat.get_languages( " << in << " )" << endl;
   }
   vector<string> vals;
+  lock_guard<mutex> lock( classify_lock );
   char *res = textcat_Classify( TC, in.c_str(), in.size() );
   if ( debug ){
     if ( res ){
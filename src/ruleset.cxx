@@ -0,0 +1,1108 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <string>
+#include <set>
+#include <map>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <climits>
+#include <stdexcept>
+#include "unicode/utf16.h"
+#include "unicode/uchar.h"
+#include "ticcutils/LogStream.h"
+#include "ticcutils/Unicode.h"
+#include "ucto/ruleset.h"
+#include "ucto/setting.h"
+
+using namespace std;
+
+#define DBG *TiCC::Log(theDbgLog)
+
+namespace Tokenizer {
+
+  using namespace icu;
+
+  namespace {
+
+    // thrown for every construct we don't want to reason about.
+    // The rule involved is then just always tried
+    class Unsupported {};
+
+    struct Part {
+      // what we know about (a part of) a regular expression
+      vector<UnicodeSet> required; // every match hits each of these classes
+      bool has_lead = false;       // every match starts with a 'lead' char
+      UnicodeSet lead;
+      bool has_anchored = false;   // the match is anchored at the start of
+      UnicodeSet anchored;         // the input, which starts with 'anchored'
+    };
+
+    struct Atom {
+      enum Kind { ZERO, ANCHOR, ANY, SET, GROUP };
+      Kind kind = ANY;
+      UnicodeSet set;
+      Part group;
+    };
+
+    UnicodeString hex_escape( UChar32 c ){
+      char buf[16];
+      snprintf( buf, sizeof(buf), "\\x{%X}", (unsigned int)c );
+      return UnicodeString( buf );
+    }
+
+    bool is_ascii_alnum( UChar32 c ){
+      return ( c >= 'a' && c <= 'z' )
+	|| ( c >= 'A' && c <= 'Z' )
+	|| ( c >= '0' && c <= '9' );
+    }
+
+    // the character classes of ICU regular expressions, expressed as
+    // UnicodeSet patterns
+    const UnicodeString digit_class = "\\p{Nd}";
+    const UnicodeString space_class = "[\\t\\n\\f\\r\\p{Z}]";
+    const UnicodeString word_class = "[\\p{Alphabetic}\\p{Mark}"
+      "\\p{Decimal_Number}\\p{Connector_Punctuation}\\u200c\\u200d]";
+
+    class Analyzer {
+    public:
+      explicit Analyzer( const UnicodeString& p ):
+	pat( p ), len( p.length() ), pos( 0 ) {};
+      bool analyze( Part& result ){
+	try {
+	  result = alternation();
+	  if ( pos != len ){
+	    // unbalanced ')'
+	    return false;
+	  }
+	}
+	catch ( const Unsupported& ){
+	  return false;
+	}
+	return true;
+      }
+    private:
+      const UnicodeString& pat;
+      const int32_t len;
+      int32_t pos;
+
+      UChar32 peek( int32_t offset = 0 ) const {
+	if ( pos + offset >= len ){
+	  return U_SENTINEL;
+	}
+	return pat.char32At( pos + offset );
+      }
+
+      void expect( UChar32 c ){
+	if ( peek() != c ){
+	  throw Unsupported();
+	}
+	++pos;
+      }
+
+      UnicodeString read_until( UChar32 end ){
+	// read the text upto (and consuming) the 'end' character
+	int32_t e = pat.indexOf( end, pos );
+	if ( e < 0 ){
+	  throw Unsupported();
+	}
+	UnicodeString result( pat, pos, e - pos );
+	pos = e + 1;
+	return result;
+      }
+
+      static UnicodeSet make_set( const UnicodeString& set_pat ){
+	UErrorCode status = U_ZERO_ERROR;
+	UnicodeSet result( set_pat, status );
+	if ( U_FAILURE(status) ){
+	  throw Unsupported();
+	}
+	return result;
+      }
+
+      Part alternation(){
+	vector<Part> branches;
+	branches.push_back( sequence() );
+	while ( peek() == '|' ){
+	  ++pos;
+	  branches.push_back( sequence() );
+	}
+	if ( branches.size() == 1 ){
+	  return branches[0];
+	}
+	Part result;
+	result.has_lead = true;
+	result.has_anchored = true;
+	bool all_required = true;
+	UnicodeSet one_of;
+	for ( const auto& b : branches ){
+	  if ( b.has_lead ){
+	    result.lead.addAll( b.lead );
+	  }
+	  else {
+	    result.has_lead = false;
+	  }
+	  if ( b.has_anchored ){
+	    result.anchored.addAll( b.anchored );
+	  }
+	  else {
+	    result.has_anchored = false;
+	  }
+	  if ( b.required.empty() ){
+	    all_required = false;
+	  }
+	  else {
+	    // every branch must hit at least one of its classes. Take the
+	    // most selective one to build a class for the alternation as a
+	    // whole
+	    auto best = min_element( b.required.begin(), b.required.end(),
+				     []( const UnicodeSet& s1,
+					 const UnicodeSet& s2 ){
+				       return s1.size() < s2.size(); } );
+	    one_of.addAll( *best );
+	  }
+	}
+	if ( all_required ){
+	  result.required.push_back( one_of );
+	}
+	if ( !result.has_lead ){
+	  result.lead.clear();
+	}
+	if ( !result.has_anchored ){
+	  result.anchored.clear();
+	}
+	return result;
+      }
+
+      Part sequence(){
+	Part result;
+	bool anchored = false;
+	bool lead_done = false;
+	while ( pos < len && peek() != '|' && peek() != ')' ){
+	  Atom a = atom();
+	  int min = quantifier();
+	  if ( a.kind == Atom::ZERO ){
+	    continue;
+	  }
+	  if ( a.kind == Atom::ANCHOR ){
+	    if ( !lead_done ){
+	      anchored = true;
+	    }
+	    continue;
+	  }
+	  bool mandatory = ( min > 0 );
+	  if ( !lead_done ){
+	    lead_done = true;
+	    if ( mandatory ){
+	      if ( a.kind == Atom::SET ){
+		result.has_lead = true;
+		result.lead = a.set;
+	      }
+	      else if ( a.kind == Atom::GROUP ){
+		if ( a.group.has_lead ){
+		  result.has_lead = true;
+		  result.lead = a.group.lead;
+		}
+		if ( !anchored && a.group.has_anchored ){
+		  result.has_anchored = true;
+		  result.anchored = a.group.anchored;
+		}
+	      }
+	      if ( anchored && result.has_lead ){
+		result.has_anchored = true;
+		result.anchored = result.lead;
+	      }
+	    }
+	  }
+	  if ( mandatory ){
+	    if ( a.kind == Atom::SET ){
+	      result.required.push_back( a.set );
+	    }
+	    else if ( a.kind == Atom::GROUP ){
+	      result.required.insert( result.required.end(),
+				      a.group.required.begin(),
+				      a.group.required.end() );
+	    }
+	  }
+	}
+	return result;
+      }
+
+      int read_number(){
+	int result = 0;
+	bool found = false;
+	while ( peek() >= '0' && peek() <= '9' ){
+	  result = result*10 + ( peek() - '0' );
+	  ++pos;
+	  found = true;
+	}
+	if ( !found ){
+	  throw Unsupported();
+	}
+	return result;
+      }
+
+      int quantifier(){
+	// returns the minimal number of repetitions
+	int min = 1;
+	switch ( peek() ){
+	case '*':
+	case '?':
+	  min = 0;
+	  ++pos;
+	  break;
+	case '+':
+	  ++pos;
+	  break;
+	case '{':
+	  ++pos;
+	  min = read_number();
+	  if ( peek() == ',' ){
+	    ++pos;
+	    if ( peek() != '}' ){
+	      read_number();
+	    }
+	  }
+	  expect( '}' );
+	  break;
+	default:
+	  return min;
+	}
+	if ( peek() == '?' || peek() == '+' ){
+	  // lazy or possessive
+	  ++pos;
+	}
+	UChar32 c = peek();
+	if ( c == '*' || c == '+' || c == '?' || c == '{' ){
+	  throw Unsupported();
+	}
+	return min;
+      }
+
+      Atom atom(){
+	Atom result;
+	UChar32 c = peek();
+	switch ( c ){
+	case '^':
+	  ++pos;
+	  result.kind = Atom::ANCHOR;
+	  break;
+	case '$':
+	  ++pos;
+	  result.kind = Atom::ZERO;
+	  break;
+	case '.':
+	  ++pos;
+	  result.kind = Atom::ANY;
+	  break;
+	case '[':
+	  result = class_atom();
+	  break;
+	case '(':
+	  result = group_atom();
+	  break;
+	case '\\':
+	  result = escape_atom();
+	  break;
+	case '*':
+	case '+':
+	case '?':
+	case '{':
+	case U_SENTINEL:
+	  throw Unsupported();
+	default:
+	  pos += U16_LENGTH(c);
+	  result.kind = Atom::SET;
+	  result.set.add( c );
+	}
+	return result;
+      }
+
+      Atom group_atom(){
+	Atom result;
+	expect( '(' );
+	bool zero_width = false;
+	if ( peek() == '?' ){
+	  UChar32 c = peek(1);
+	  switch ( c ){
+	  case ':':
+	  case '>':
+	    pos += 2;
+	    break;
+	  case '=':
+	  case '!':
+	    // look-ahead
+	    pos += 2;
+	    zero_width = true;
+	    break;
+	  case '<':
+	    if ( peek(2) == '=' || peek(2) == '!' ){
+	      // look-behind
+	      pos += 3;
+	      zero_width = true;
+	    }
+	    else {
+	      // named capture group
+	      pos += 2;
+	      read_until( '>' );
+	    }
+	    break;
+	  case '#':
+	    read_until( ')' );
+	    result.kind = Atom::ZERO;
+	    return result;
+	  default:
+	    // flag settings like (?i) change the meaning of everything
+	    throw Unsupported();
+	  }
+	}
+	Part inner = alternation();
+	expect( ')' );
+	if ( zero_width ){
+	  result.kind = Atom::ZERO;
+	}
+	else {
+	  result.kind = Atom::GROUP;
+	  result.group = inner;
+	}
+	return result;
+      }
+
+      UnicodeString property(){
+	// we are just behind a '\p' or '\P'
+	if ( peek() == '{' ){
+	  ++pos;
+	  return "{" + read_until( '}' ) + "}";
+	}
+	UChar32 c = peek();
+	if ( c == U_SENTINEL ){
+	  throw Unsupported();
+	}
+	pos += U16_LENGTH(c);
+	return UnicodeString( c );
+      }
+
+      UnicodeString escaped_char(){
+	// we are at the '\' of an escape sequence for one character,
+	// like \x{263A}, é or \t
+	UChar32 c = pat.unescapeAt( ++pos );
+	if ( c == U_SENTINEL ){
+	  throw Unsupported();
+	}
+	return hex_escape( c );
+      }
+
+      Atom escape_atom(){
+	Atom result;
+	UChar32 c = peek(1);
+	switch ( c ){
+	case 'b':
+	case 'B':
+	case 'A':
+	case 'z':
+	case 'Z':
+	case 'G':
+	  pos += 2;
+	  result.kind = ( c == 'A' ) ? Atom::ANCHOR : Atom::ZERO;
+	  break;
+	case 'd':
+	case 's':
+	case 'w':
+	case 'D':
+	case 'S':
+	case 'W': {
+	  pos += 2;
+	  result.kind = Atom::SET;
+	  UnicodeString set_pat;
+	  switch ( u_tolower(c) ){
+	  case 'd':
+	    set_pat = digit_class;
+	    break;
+	  case 's':
+	    set_pat = space_class;
+	    break;
+	  default:
+	    set_pat = word_class;
+	  }
+	  result.set = make_set( "[" + set_pat + "]" );
+	  if ( u_isupper(c) ){
+	    result.set.complement();
+	  }
+	}
+	  break;
+	case 'p':
+	case 'P': {
+	  pos += 2;
+	  UnicodeString set_pat = "[\\";
+	  set_pat += c;
+	  set_pat += property() + "]";
+	  result.kind = Atom::SET;
+	  result.set = make_set( set_pat );
+	}
+	  break;
+	case 'N':
+	  pos += 2;
+	  expect( '{' );
+	  result.kind = Atom::SET;
+	  result.set = make_set( "[\\N{" + read_until( '}' ) + "}]" );
+	  break;
+	case 'x':
+	case 'u':
+	case 'U':
+	case 't':
+	case 'n':
+	case 'r':
+	case 'f':
+	case 'a':
+	case 'e':
+	  result.kind = Atom::SET;
+	  result.set = make_set( "[" + escaped_char() + "]" );
+	  break;
+	case 'X':
+	case 'R':
+	case 'h':
+	case 'H':
+	case 'v':
+	case 'V':
+	  pos += 2;
+	  result.kind = Atom::ANY;
+	  break;
+	case 'k':
+	  // named back reference
+	  pos += 2;
+	  expect( '<' );
+	  read_until( '>' );
+	  result.kind = Atom::ANY;
+	  break;
+	case U_SENTINEL:
+	  throw Unsupported();
+	default:
+	  if ( c >= '1' && c <= '9' ){
+	    // back reference
+	    pos += 1;
+	    read_number();
+	    result.kind = Atom::ANY;
+	  }
+	  else if ( c < 0x80 && u_isalnum(c) ){
+	    // \Q..\E, octals, control chars and the like
+	    throw Unsupported();
+	  }
+	  else {
+	    // an escaped literal
+	    pos += 1 + U16_LENGTH(c);
+	    result.kind = Atom::SET;
+	    result.set.add( c );
+	  }
+	}
+	return result;
+      }
+
+      UnicodeString class_pattern(){
+	// translate a [] class of an ICU regex into an equivalent
+	// UnicodeSet pattern.
+	expect( '[' );
+	UnicodeString result = "[";
+	if ( peek() == '^' ){
+	  ++pos;
+	  result += "^";
+	}
+	if ( peek() == ']' ){
+	  throw Unsupported();
+	}
+	if ( peek() == ':' && pat.indexOf( ":]", pos ) >= 0 ){
+	  // might be a POSIX like [:alpha:]
+	  throw Unsupported();
+	}
+	bool prev_literal = false;
+	while ( true ){
+	  UChar32 c = peek();
+	  switch ( c ){
+	  case U_SENTINEL:
+	    throw Unsupported();
+	  case ']':
+	    ++pos;
+	    return result + "]";
+	  case '[':
+	    if ( peek(1) == ':' ){
+	      // a POSIX like [:alpha:], UnicodeSet knows these
+	      int32_t e = pat.indexOf( ":]", pos );
+	      if ( e < 0 ){
+		throw Unsupported();
+	      }
+	      result += UnicodeString( pat, pos, e + 2 - pos );
+	      pos = e + 2;
+	    }
+	    else {
+	      result += class_pattern();
+	    }
+	    prev_literal = false;
+	    break;
+	  case '&':
+	    if ( peek(1) == '&' ){
+	      // set intersection
+	      throw Unsupported();
+	    }
+	    ++pos;
+	    result += hex_escape( c );
+	    prev_literal = true;
+	    break;
+	  case '-':
+	    if ( peek(1) == ']' ){
+	      ++pos;
+	      result += hex_escape( c );
+	    }
+	    else if ( prev_literal && peek(1) != '-' && peek(1) != '[' ){
+	      // a range
+	      ++pos;
+	      result += "-";
+	    }
+	    else {
+	      throw Unsupported();
+	    }
+	    prev_literal = false;
+	    break;
+	  case '\\': {
+	    UChar32 e = peek(1);
+	    switch ( e ){
+	    case 'd':
+	    case 'D':
+	      pos += 2;
+	      result += ( e == 'd' ) ? "\\p{Nd}" : "\\P{Nd}";
+	      prev_literal = false;
+	      break;
+	    case 's':
+	    case 'S':
+	    case 'w':
+	    case 'W': {
+	      pos += 2;
+	      UnicodeString set_pat = ( u_tolower(e) == 's' ) ? space_class
+		: word_class;
+	      if ( u_isupper(e) ){
+		set_pat = "[^" + UnicodeString( set_pat, 1 );
+	      }
+	      result += set_pat;
+	      prev_literal = false;
+	    }
+	      break;
+	    case 'p':
+	    case 'P':
+	      pos += 2;
+	      result += "\\";
+	      result += e;
+	      result += property();
+	      prev_literal = false;
+	      break;
+	    case 'N':
+	      pos += 2;
+	      expect( '{' );
+	      result += "\\N{" + read_until( '}' ) + "}";
+	      prev_literal = true;
+	      break;
+	    case 'x':
+	    case 'u':
+	    case 'U':
+	    case 't':
+	    case 'n':
+	    case 'r':
+	    case 'f':
+	    case 'a':
+	    case 'e':
+	      result += escaped_char();
+	      prev_literal = true;
+	      break;
+	    case U_SENTINEL:
+	      throw Unsupported();
+	    default:
+	      if ( e < 0x80 && u_isalnum(e) ){
+		throw Unsupported();
+	      }
+	      pos += 1 + U16_LENGTH(e);
+	      result += hex_escape( e );
+	      prev_literal = true;
+	    }
+	  }
+	    break;
+	  default:
+	    pos += U16_LENGTH(c);
+	    if ( is_ascii_alnum( c ) ){
+	      result += c;
+	    }
+	    else {
+	      result += hex_escape( c );
+	    }
+	    prev_literal = true;
+	  }
+	}
+      }
+
+      Atom class_atom(){
+	Atom result;
+	result.kind = Atom::SET;
+	result.set = make_set( class_pattern() );
+	return result;
+      }
+
+    };
+
+  } // anonymous namespace
+
+  RuleSet::RuleSet(){
+  }
+
+  int RuleSet::class_index( const UnicodeSet& set ){
+    /*!
+      \param set a character class
+      \return the index of this class in our table, adding it when needed.
+      -1 when the table is full
+    */
+    for ( size_t i=0; i < classes.size(); ++i ){
+      if ( classes[i] == set ){
+	return i;
+      }
+    }
+    if ( classes.size() >= MAX_CLASSES ){
+      return -1;
+    }
+    classes.push_back( set );
+    classes.back().freeze();
+    return classes.size() - 1;
+  }
+
+  void RuleSet::compile( const vector<Rule *>& rules,
+			 int tokDebug,
+			 TiCC::LogStream *theDbgLog ){
+    /*!
+      \param rules The rules of a Setting, in the order of application
+      \param tokDebug the debug level
+      \param theDbgLog the stream for debug output
+
+      For every rule we derive the classes of characters that MUST be
+      present in a word for that rule to match. We keep the most selective
+      ones. Rules we cannot analyse get no requirements, so they are
+      always tried.
+    */
+    classes.clear();
+    required.clear();
+    required_first.clear();
+    const size_t max_per_rule = 3;
+    for ( const auto& rule : rules ){
+      ClassMask req;
+      ClassMask req_first;
+      Part part;
+      Analyzer an( rule->pattern );
+      if ( an.analyze( part ) ){
+	vector<UnicodeSet> sets = part.required;
+	sort( sets.begin(), sets.end(),
+	      []( const UnicodeSet& s1, const UnicodeSet& s2 ){
+		return s1.size() < s2.size(); } );
+	sets.erase( unique( sets.begin(), sets.end() ), sets.end() );
+	size_t taken = 0;
+	for ( const auto& s : sets ){
+	  if ( taken == max_per_rule ){
+	    break;
+	  }
+	  int index = class_index( s );
+	  if ( index >= 0 ){
+	    req.set( index );
+	    ++taken;
+	  }
+	}
+	if ( part.has_anchored ){
+	  int index = class_index( part.anchored );
+	  if ( index >= 0 ){
+	    req_first.set( index );
+	  }
+	}
+	if ( tokDebug > 5 ){
+	  DBG << "rule " << rule->id << " needs " << req.count()
+	      << " character classes"
+	      << ( req_first.any() ? ", anchored" : "" ) << endl;
+	}
+      }
+      else if ( tokDebug > 5 ){
+	DBG << "rule " << rule->id << " is always tried" << endl;
+      }
+      required.push_back( req );
+      required_first.push_back( req_first );
+    }
+    fill_low_table();
+    if ( tokDebug ){
+      DBG << "rule prefilter: " << filtered() << " of " << size()
+	  << " rules use " << classes.size() << " character classes" << endl;
+    }
+  }
+
+  void RuleSet::restore( const vector<UnicodeSet>& cls,
+			 const vector<ClassMask>& req,
+			 const vector<ClassMask>& req_first ){
+    /*!
+      \param cls the character classes
+      \param req the required classes per rule
+      \param req_first the required classes of the first character per rule
+
+      restore a RuleSet from the results of an earlier compile(), f.e. as
+      stored in a compiled settings file
+    */
+    if ( cls.size() > MAX_CLASSES
+	 || req.size() != req_first.size() ){
+      throw std::invalid_argument( "ucto: invalid RuleSet data" );
+    }
+    classes = cls;
+    required = req;
+    required_first = req_first;
+    fill_low_table();
+  }
+
+  void RuleSet::fill_low_table(){
+    low_table.assign( LOW_TABLE_SIZE, ClassMask() );
+    for ( size_t i=0; i < classes.size(); ++i ){
+      for ( UChar32 c=0; c < LOW_TABLE_SIZE; ++c ){
+	if ( classes[i].contains( c ) ){
+	  low_table[c].set( i );
+	}
+      }
+    }
+  }
+
+  size_t RuleSet::filtered() const {
+    /*!
+      \return the number of rules which may be skipped based on a scan
+    */
+    size_t result = 0;
+    for ( size_t i=0; i < required.size(); ++i ){
+      if ( required[i].any() || required_first[i].any() ){
+	++result;
+      }
+    }
+    return result;
+  }
+
+  RuleSet::ClassMask RuleSet::char_mask( UChar32 c ) const {
+    if ( c >= 0 && c < LOW_TABLE_SIZE ){
+      return low_table[c];
+    }
+    ClassMask result;
+    for ( size_t i=0; i < classes.size(); ++i ){
+      if ( classes[i].contains( c ) ){
+	result.set( i );
+      }
+    }
+    return result;
+  }
+
+  RuleSet::Signature RuleSet::scan( const UnicodeString& word ) const {
+    /*!
+      \param word the word to scan
+      \return the Signature of the word: which character classes are
+      present, and the classes of the first character
+    */
+    Signature result;
+    if ( classes.empty() ){
+      return result;
+    }
+    const UChar *buf = word.getBuffer();
+    int32_t len = word.length();
+    int32_t i = 0;
+    bool first = true;
+    while ( i < len ){
+      UChar32 c;
+      U16_NEXT( buf, i, len, c );
+      ClassMask m = char_mask( c );
+      if ( first ){
+	result.first = m;
+	first = false;
+      }
+      result.all |= m;
+    }
+    return result;
+  }
+
+  namespace {
+
+    // characters with a special meaning in an ICU regular expression
+    const UnicodeString regex_meta = "\\^$.|?*+()[]{}";
+
+    // the atom for a '.' in a list entry
+    const UChar32 WILDCARD = -1;
+
+    bool split_literal( const UnicodeString& entry,
+			vector<UChar32>& atoms ){
+      // split an entry of a list in 'atoms', which all match exactly one
+      // character: a (possibly escaped) literal or a '.'
+      // returns false for entries using any other regex syntax
+      atoms.clear();
+      const int32_t len = entry.length();
+      int32_t i = 0;
+      while ( i < len ){
+	UChar32 c = entry.char32At( i );
+	if ( c == '\\' ){
+	  if ( i + 1 >= len ){
+	    return false;
+	  }
+	  c = entry.char32At( i + 1 );
+	  if ( c < 0x80 && u_isalnum( c ) ){
+	    // \p{}, \d, \u.... and friends
+	    return false;
+	  }
+	  i += 1 + U16_LENGTH(c);
+	}
+	else if ( c == '.' ){
+	  c = WILDCARD;
+	  ++i;
+	}
+	else if ( regex_meta.indexOf( c ) >= 0 ){
+	  return false;
+	}
+	else {
+	  i += U16_LENGTH(c);
+	}
+	atoms.push_back( c );
+      }
+      return true;
+    }
+
+    void append_atom( UnicodeString& out, UChar32 atom ){
+      if ( atom == WILDCARD ){
+	out += '.';
+      }
+      else {
+	if ( regex_meta.indexOf( atom ) >= 0 ){
+	  out += '\\';
+	}
+	out += atom;
+      }
+    }
+
+    struct TrieNode {
+      int end = -1;      // index of the entry ending here, if any
+      int min = INT_MAX; // lowest entry index in this subtree
+      int max = -1;      // highest entry index in this subtree
+      int count = 0;     // number of entries in this subtree
+      map<UChar32, unique_ptr<TrieNode>> children;
+      // filled by plan():
+      bool factored = true;     // false: use a plain alternation
+      // the branches, in the order they must be tried. A 0 node stands
+      // for the entry ending here
+      vector<pair<UChar32,TrieNode *>> order;
+      size_t branches() const {
+	return factored ? order.size() : count;
+      }
+    };
+
+    void insert( TrieNode& root,
+		 const vector<UChar32>& atoms,
+		 int index ){
+      vector<TrieNode *> path;
+      TrieNode *node = &root;
+      for ( const auto& atom : atoms ){
+	path.push_back( node );
+	auto& child = node->children[atom];
+	if ( !child ){
+	  child.reset( new TrieNode() );
+	}
+	node = child.get();
+      }
+      if ( node->end >= 0 ){
+	// a duplicate. The first one wins anyway
+	return;
+      }
+      node->end = index;
+      path.push_back( node );
+      for ( const auto& n : path ){
+	n->min = std::min( n->min, index );
+	n->max = std::max( n->max, index );
+	++n->count;
+      }
+    }
+
+    void plan( TrieNode& node ){
+      // decide in which order the branches below this node must be tried,
+      // to mimic the plain alternation
+      typedef pair<UChar32,TrieNode *> branch;
+      vector<branch> kids;
+      bool has_wild = false;
+      for ( const auto& it : node.children ){
+	plan( *it.second );
+	if ( it.first == WILDCARD ){
+	  has_wild = true;
+	}
+	kids.push_back( make_pair( it.first, it.second.get() ) );
+      }
+      sort( kids.begin(), kids.end(),
+	    []( const branch& b1, const branch& b2 ){
+	      return b1.second->min < b2.second->min; } );
+      const branch end_here( 0, 0 );
+      node.order.clear();
+      node.factored = true;
+      if ( has_wild ){
+	// a '.' overlaps with every other branch, so ALL entries must be
+	// tried in the original order
+	bool end_done = ( node.end < 0 );
+	int last = -1;
+	for ( const auto& kid : kids ){
+	  if ( !end_done && node.end < kid.second->min ){
+	    if ( last > node.end ){
+	      node.factored = false;
+	    }
+	    node.order.push_back( end_here );
+	    last = node.end;
+	    end_done = true;
+	  }
+	  if ( kid.second->min < last ){
+	    node.factored = false;
+	  }
+	  node.order.push_back( kid );
+	  last = kid.second->max;
+	}
+	if ( !end_done ){
+	  node.factored = node.factored && last < node.end;
+	  node.order.push_back( end_here );
+	}
+      }
+      else {
+	// different literals never match the same input, so only the order
+	// of an entry ending here, and the longer ones continuing it matters
+	if ( node.end >= 0 ){
+	  for ( const auto& kid : kids ){
+	    if ( kid.second->max < node.end ){
+	      node.order.push_back( kid );
+	    }
+	    else if ( kid.second->min < node.end ){
+	      node.factored = false;
+	    }
+	  }
+	  node.order.push_back( end_here );
+	}
+	for ( const auto& kid : kids ){
+	  if ( node.end < 0 || kid.second->min > node.end ){
+	    node.order.push_back( kid );
+	  }
+	}
+      }
+    }
+
+    void collect( const TrieNode& node,
+		  const UnicodeString& prefix,
+		  vector<pair<int,UnicodeString>>& result ){
+      if ( node.end >= 0 ){
+	result.push_back( make_pair( node.end, prefix ) );
+      }
+      for ( const auto& it : node.children ){
+	UnicodeString ext = prefix;
+	append_atom( ext, it.first );
+	collect( *it.second, ext, result );
+      }
+    }
+
+    void write( const TrieNode& node, UnicodeString& out ){
+      // write the alternatives below this node, separated by '|'
+      if ( !node.factored ){
+	// no factoring possible here, use the plain alternation
+	vector<pair<int,UnicodeString>> all;
+	collect( node, "", all );
+	sort( all.begin(), all.end() );
+	for ( size_t i=0; i < all.size(); ++i ){
+	  if ( i > 0 ){
+	    out += '|';
+	  }
+	  out += all[i].second;
+	}
+	return;
+      }
+      bool first = true;
+      for ( const auto& kid : node.order ){
+	if ( !first ){
+	  out += '|';
+	}
+	first = false;
+	const TrieNode *next = kid.second;
+	if ( next == 0 ){
+	  // an entry ends here
+	  continue;
+	}
+	append_atom( out, kid.first );
+	if ( next->branches() > 1 ){
+	  out += "(?:";
+	  write( *next, out );
+	  out += ')';
+	}
+	else {
+	  write( *next, out );
+	}
+      }
+    }
+
+  } // anonymous namespace
+
+  UnicodeString compile_list( const vector<UnicodeString>& entries ){
+    /*!
+      \param entries a list of (regex) alternatives
+      \return one regular expression, equivalent to joining all entries
+      with '|'
+
+      Consecutive literal entries are stored in a trie and written out in
+      factored form. Entries that use other regex syntax are kept as is, in
+      their original position.
+    */
+    UnicodeString result;
+    auto append = [&result]( const UnicodeString& part ){
+      if ( !result.isEmpty() ){
+	result += "|";
+      }
+      result += part;
+    };
+    unique_ptr<TrieNode> root;
+    auto flush = [&](){
+      if ( root ){
+	plan( *root );
+	UnicodeString part;
+	write( *root, part );
+	append( part );
+	root.reset();
+      }
+    };
+    vector<UChar32> atoms;
+    int index = 0;
+    for ( const auto& entry : entries ){
+      if ( split_literal( entry, atoms ) ){
+	if ( !root ){
+	  root.reset( new TrieNode() );
+	}
+	insert( *root, atoms, index++ );
+      }
+      else {
+	flush();
+	append( entry );
+      }
+    }
+    flush();
+    return result;
+  }
+
+} // namespace Tokenizer
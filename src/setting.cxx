@@ -27,6 +27,9 @@
 
 #include <unistd.h>
 #include <pwd.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <iostream>
@@ -36,6 +39,8 @@
 #include <algorithm>
 #include <functional>  // for std::plus
 #include <numeric>     // for std::accumulate
+#include <memory>
+#include <mutex>
 #include "config.h"
 #include "ticcutils/StringOps.h"
 #include "ticcutils/FileUtils.h"
@@ -43,6 +48,9 @@
 #include "ticcutils/LogStream.h"
 #include "ticcutils/Unicode.h"
 #include "libfolia/folia.h"
+#include "unicode/uversion.h"
+#include "unicode/uchar.h"
+#include "ucto/cachefile.h"
 #include "ucto/setting.h"
 
 using namespace std;
@@ -146,19 +154,13 @@ namespace Tokenizer {
     return os;
   }
 
-  void Quoting::flushStack( int beginindex ) {
+  void QuoteStack::flush( int beginindex ) {
     //flush up to (but not including) the specified index
-    if ( !quotestack.empty() ){
-      std::vector<int> new_quoteindexstack;
-      std::vector<UChar32> new_quotestack;
-      for ( size_t i = 0; i < quotestack.size(); i++) {
-	if (quoteindexstack[i] >= beginindex ) {
-	  new_quotestack.push_back(quotestack[i]);
-	  new_quoteindexstack.push_back(quoteindexstack[i]-beginindex);
-	}
-      }
-      quoteindexstack = new_quoteindexstack;
-      quotestack = new_quotestack;
+    stackbase += beginindex;
+    while ( !quoteindexstack.empty()
+	    && quoteindexstack.front() < stackbase ){
+      quoteindexstack.pop_front();
+      quotestack.pop_front();
     }
   }
 
@@ -167,16 +169,66 @@ namespace Tokenizer {
     quote.openQuote = o;
     quote.closeQuote = c;
     _quotes.push_back( quote );
+    // mark the characters, for a fast isQuote()
+    if ( !c.isEmpty() ){
+      for ( int32_t i=0; i < o.length(); i = o.moveIndex32( i, 1 ) ){
+	chars.add( o.char32At( i ), CharTable::QUOTE_OPEN );
+      }
+    }
+    if ( !o.isEmpty() ){
+      for ( int32_t i=0; i < c.length(); i = c.moveIndex32( i, 1 ) ){
+	chars.add( c.char32At( i ), CharTable::QUOTE_CLOSE );
+      }
+    }
+  }
+
+  void FilterTable::compile( TiCC::UniFilter& filter,
+			     const vector<UnicodeString>& lines ){
+    /// build the table from the FILTER entries
+    /*!
+      \param filter the filter to compile
+      \param lines the entries filter was filled with
+
+      We only take the character to replace from every entry. What it is
+      replaced by, we ask filter itself, so the table does just what
+      filter.filter() would.
+    */
+    bits.assign( BMP_SIZE/64, 0 );
+    replacements.clear();
+    for ( const auto& entry : lines ){
+      UnicodeString line = entry;
+      line.trim();
+      if ( line.isEmpty() || line[0] == '#' ){
+	continue;
+      }
+      int32_t end = 0;
+      while ( end < line.length()
+	      && line[end] != ' '
+	      && line[end] != '\t' ){
+	++end;
+      }
+      const UnicodeString key = UnicodeString( line, 0, end ).unescape();
+      if ( key.countChar32() != 1 ){
+	continue;
+      }
+      const UChar32 c = key.char32At( 0 );
+      const UnicodeString replacement = filter.filter( key );
+      if ( replacement != key ){
+	replacements[c] = replacement;
+	const UChar u = U_IS_BMP( c ) ? c : U16_LEAD( c );
+	bits[u >> 6] |= uint64_t(1) << ( u & 63 );
+      }
+    }
   }
 
-  int Quoting::lookup( const UnicodeString& open, int& stackindex ){
+  int QuoteStack::lookup( const UnicodeString& open, int& stackindex ) const {
     if (quotestack.empty() || (quotestack.size() != quoteindexstack.size())) return -1;
     auto it = quotestack.crbegin();
     size_t i = quotestack.size();
     while ( it != quotestack.crend() ){
       if ( open.indexOf( *it ) >= 0 ){
  	stackindex = i-1;
- 	return quoteindexstack[stackindex];
+	return quoteindexstack[stackindex] - stackbase;
       }
       --i;
       ++it;
@@ -205,47 +257,165 @@ namespace Tokenizer {
     return "";
   }
 
-  Rule::~Rule() {
-    delete regexp;
+  namespace {
+
+    // All compiled patterns in the process, on their source. Like the
+    // registry of Settings, this is never deleted, so it is still there
+    // when the last Rule goes, whenever that is.
+    struct PatternCache {
+      mutex lock;
+      map<UnicodeString, weak_ptr<const RegexPattern>> patterns;
+    };
+
+    PatternCache& pattern_cache(){
+      static PatternCache *cache = new PatternCache();
+      return *cache;
+    }
+
+    void release_pattern( const RegexPattern *regexp ){
+      // the last Rule with this pattern is gone
+      PatternCache& cache = pattern_cache();
+      {
+	lock_guard<mutex> lock( cache.lock );
+	auto it = cache.patterns.find( regexp->pattern() );
+	if ( it != cache.patterns.end()
+	     && it->second.expired() ){
+	  cache.patterns.erase( it );
+	}
+      }
+      delete regexp;
+    }
+
   }
 
   Rule::Rule( const UnicodeString& _id, const UnicodeString& _pattern):
     id(_id), pattern(_pattern) {
-    regexp = new TiCC::UnicodeRegexMatcher( pattern, id );
+    PatternCache& cache = pattern_cache();
+    {
+      lock_guard<mutex> lock( cache.lock );
+      auto it = cache.patterns.find( pattern );
+      if ( it != cache.patterns.end() ){
+	regexp = it->second.lock();
+	if ( regexp ){
+	  return;
+	}
+      }
+    }
+    // compile without holding the lock, other Settings may be read at the
+    // same time
+    UParseError errorInfo;
+    UErrorCode u_stat = U_ZERO_ERROR;
+    RegexPattern *compiled = RegexPattern::compile( pattern, 0,
+						    errorInfo, u_stat );
+    if ( U_FAILURE( u_stat ) ){
+      delete compiled;
+      throw uConfigError( "invalid regular expression for rule "
+			  + TiCC::UnicodeToUTF8( id ) + " at position "
+			  + TiCC::toString( errorInfo.offset )
+			  + ": " + TiCC::UnicodeToUTF8( pattern ), "" );
+    }
+    shared_ptr<const RegexPattern> ours( compiled, release_pattern );
+    lock_guard<mutex> lock( cache.lock );
+    weak_ptr<const RegexPattern>& known = cache.patterns[pattern];
+    regexp = known.lock();
+    if ( !regexp ){
+      // nobody was quicker
+      regexp = ours;
+      known = regexp;
+    }
+  }
+
+  RegexMatcher *Rule::new_matcher() const {
+    /// create a matcher for this rule
+    /*!
+      \return a new RegexMatcher, owned by the caller. 0 for an empty Rule
+    */
+    if ( !regexp ){
+      return 0;
+    }
+    UErrorCode u_stat = U_ZERO_ERROR;
+    RegexMatcher *matcher = regexp->matcher( u_stat );
+    if ( U_FAILURE( u_stat ) ){
+      delete matcher;
+      throw uLogicError( "unable to create a matcher for rule "
+			 + TiCC::UnicodeToUTF8( id ) );
+    }
+    return matcher;
   }
 
   ostream& operator<< (std::ostream& os, const Rule& r ){
     if ( r.regexp ){
-      os << r.id << "=\"" << r.regexp->Pattern() << "\"";
+      os << r.id << "=\"" << r.regexp->pattern() << "\"";
     }
     else
       os << r.id  << "=NULL";
     return os;
   }
 
-  bool Rule::matchAll( const UnicodeString& line,
-		       UnicodeString& pre,
-		       UnicodeString& post,
-		       vector<UnicodeString>& matches ){
+  bool Rule::matchAll( RegexMatcher& matcher,
+		       const UnicodeString& line,
+		       Span& pre,
+		       Span& post,
+		       vector<Span>& matches ) const {
+    /// match the rule against a string
+    /*!
+      \param matcher a matcher for this rule, see new_matcher()
+      \param line the string to match
+      \param pre the part of line before the match
+      \param post the part of line after the match
+      \param matches the matched groups, or the whole match when the
+      pattern has no (matching) groups
+      \return true when the rule matches
+
+      All results are Spans into line, so nothing is copied. The division
+      is the same as TiCC::UnicodeRegexMatcher::match_all() makes.
+    */
     matches.clear();
-    pre = "";
-    post = "";
+    pre = Span();
+    post = Span();
 #ifdef MATCH_DEBUG
     cerr << "match: " << id << endl;
 #endif
-    if ( regexp && regexp->match_all( line, pre, post ) ){
-      int num = regexp->NumOfMatches();
-      if ( num >=1 ){
-	for( int i=1; i <= num; ++i ){
-	  matches.push_back( regexp->get_match( i ) );
-	}
+    matcher.reset( line );
+    if ( !matcher.find() ){
+      return false;
+    }
+    const int32_t len = line.length();
+    const int groups = matcher.groupCount();
+    Span whole;
+    int32_t end = 0;
+    for ( int i=0; i <= groups; ++i ){
+      UErrorCode u_stat = U_ZERO_ERROR;
+      int32_t start = matcher.start( i, u_stat );
+      if ( U_FAILURE(u_stat) ){
+	break;
+      }
+      if ( start < 0 ){
+	// this group didn't participate
+	continue;
+      }
+      if ( start > end ){
+	pre = Span( end, min( start, len - end ) );
+      }
+      end = matcher.end( i, u_stat );
+      if ( U_FAILURE(u_stat) ){
+	break;
+      }
+      if ( i == 0 ){
+	whole = Span( start, end - start );
+	matches.reserve( groups > 0 ? groups : 1 );
       }
       else {
-	matches.push_back( regexp->get_match( 0 ) );
+	matches.push_back( Span( start, end - start ) );
       }
-      return true;
     }
-    return false;
+    if ( end < len ){
+      post = Span( end, len - end );
+    }
+    if ( matches.empty() ){
+      matches.push_back( whole );
+    }
+    return true;
   }
 
   Setting::~Setting(){
@@ -317,7 +487,20 @@ namespace Tokenizer {
     if ( tokDebug > 0 ){
       DBG << "%include " << fname << endl;
     }
-    return filter.fill( fname );
+    if ( !filter.fill( fname ) ){
+      return false;
+    }
+    // remember the entries, for save_compiled()
+    ifstream f( fname );
+    string rawline;
+    while ( getline( f, rawline ) ){
+      UnicodeString line = TiCC::UnicodeFromUTF8(rawline);
+      line.trim();
+      if ((line.length() > 0) && (line[0] != '#')) {
+	filter_lines.push_back( line );
+      }
+    }
+    return true;
   }
 
   bool Setting::read_quotes( const string& fname ){
@@ -424,7 +607,7 @@ namespace Tokenizer {
   }
 
   bool Setting::read_abbreviations( const string& fname,
-				    UnicodeString& abbreviations ){
+				    vector<UnicodeString>& abbreviations ){
     if ( tokDebug > 0 ){
       DBG << "%include " << fname << endl;
     }
@@ -441,11 +624,7 @@ namespace Tokenizer {
 	  if ( tokDebug >= 5 ){
 	    DBG << "include line = " << rawline << endl;
 	  }
-	  line = escape_regex( line );
-	  if ( !abbreviations.isEmpty()){
-	    abbreviations += '|';
-	  }
-	  abbreviations += line;
+	  abbreviations.push_back( escape_regex( line ) );
 	}
       }
     }
@@ -596,6 +775,494 @@ namespace Tokenizer {
     return result;
   }
 
+  namespace {
+
+    // the layout of a compiled settings file. Increment FORMAT_VERSION
+    // whenever it changes.
+    const char MAGIC[8] = { 'U', 'C', 'T', 'O', 'S', 'E', 'T', '\0' };
+    const uint32_t FORMAT_VERSION = 2;
+    const uint32_t ENDIAN_MARK = 0x01020304;
+
+    string icu_version(){
+      // the ICU library we run with, and its Unicode version. The character
+      // classes in the RuleSet depend on these
+      UVersionInfo info;
+      char icu[U_MAX_VERSION_STRING_LENGTH];
+      u_getVersion( info );
+      u_versionToString( info, icu );
+      char unicode[U_MAX_VERSION_STRING_LENGTH];
+      u_getUnicodeVersion( info );
+      u_versionToString( info, unicode );
+      return string( icu ) + "/" + unicode;
+    }
+
+    uint64_t content_hash( const string& name ){
+      // FNV-1a of the contents of a file
+      uint64_t hash = 14695981039346656037ULL;
+      ifstream is( name, ios::binary );
+      vector<char> buf( 64*1024 );
+      while ( is.read( buf.data(), buf.size() ) || is.gcount() > 0 ){
+	for ( streamsize i=0; i < is.gcount(); ++i ){
+	  hash ^= static_cast<unsigned char>( buf[i] );
+	  hash *= 1099511628211ULL;
+	}
+      }
+      return hash;
+    }
+
+    vector<uint64_t> content_hashes( const vector<string>& files ){
+      vector<uint64_t> result;
+      result.reserve( files.size() );
+      for ( const auto& file : files ){
+	result.push_back( content_hash( file ) );
+      }
+      return result;
+    }
+
+    // The Settings in use in the process, on the settingsfile they were
+    // read from. The registry is never deleted, so Settings may outlive
+    // static Tokenizers.
+    struct SharedSetting {
+      mutex lock;                      // held while reading the Setting
+      weak_ptr<const Setting> setting;
+      vector<uint64_t> hashes;         // of its source_files
+    };
+
+    struct SettingRegistry {
+      mutex lock;
+      map<string, shared_ptr<SharedSetting>> entries;
+    };
+
+    SettingRegistry& setting_registry(){
+      static SettingRegistry *registry = new SettingRegistry();
+      return *registry;
+    }
+
+    class BinWriter {
+    public:
+      explicit BinWriter( ostream& os ): out( os ){};
+      void u32( uint32_t v ){
+	out.write( reinterpret_cast<const char*>(&v), sizeof(v) );
+      }
+      void u64( uint64_t v ){
+	out.write( reinterpret_cast<const char*>(&v), sizeof(v) );
+      }
+      void str( const string& s ){
+	u32( s.size() );
+	out.write( s.data(), s.size() );
+      }
+      void ustr( const UnicodeString& us ){
+	u32( us.length() );
+	out.write( reinterpret_cast<const char*>(us.getBuffer()),
+		   us.length() * sizeof(UChar) );
+      }
+      void mask( const RuleSet::ClassMask& m ){
+	const RuleSet::ClassMask low( ~uint64_t(0) );
+	for ( size_t shift=0; shift < RuleSet::MAX_CLASSES; shift += 64 ){
+	  u64( ( ( m >> shift ) & low ).to_ullong() );
+	}
+      }
+    private:
+      ostream& out;
+    };
+
+    class BinReader {
+      // reads from a (memory mapped) buffer. Throws when running out of data
+    public:
+      BinReader( const char *b, size_t len ): pos( b ), end( b + len ){};
+      void raw( void *to, size_t len ){
+	if ( len > size_t( end - pos ) ){
+	  throw runtime_error( "truncated" );
+	}
+	memcpy( to, pos, len );
+	pos += len;
+      }
+      uint32_t u32(){
+	uint32_t v;
+	raw( &v, sizeof(v) );
+	return v;
+      }
+      uint64_t u64(){
+	uint64_t v;
+	raw( &v, sizeof(v) );
+	return v;
+      }
+      uint32_t count(){
+	// the number of items that follow. They take at least 4 bytes each
+	uint32_t n = u32();
+	if ( n > size_t( end - pos ) / 4 ){
+	  throw runtime_error( "invalid count" );
+	}
+	return n;
+      }
+      string str(){
+	uint32_t len = u32();
+	if ( len > size_t( end - pos ) ){
+	  throw runtime_error( "truncated" );
+	}
+	string result( len, '\0' );
+	raw( &result[0], len );
+	return result;
+      }
+      UnicodeString ustr(){
+	uint32_t len = u32();
+	if ( len > size_t( end - pos ) / sizeof(UChar) ){
+	  throw runtime_error( "truncated" );
+	}
+	UnicodeString result;
+	UChar *buf = result.getBuffer( len );
+	raw( buf, len * sizeof(UChar) );
+	result.releaseBuffer( len );
+	return result;
+      }
+      RuleSet::ClassMask mask(){
+	RuleSet::ClassMask result;
+	for ( size_t shift=0; shift < RuleSet::MAX_CLASSES; shift += 64 ){
+	  result |= RuleSet::ClassMask( u64() ) << shift;
+	}
+	return result;
+      }
+      bool at_end() const { return pos == end; };
+    private:
+      const char *pos;
+      const char *end;
+    };
+
+  }
+
+  string Setting::compiled_name( const string& conffile,
+				 const string& add_tokens ){
+    /// the name of the compiled version of a settingsfile
+    /*!
+      \param conffile the settingsfile
+      \param add_tokens the file with additional TOKENS, if any
+      \return the name of the compiled file, in the local cachedir
+    */
+    string result = local_cache_dir() + TiCC::basename( conffile );
+    if ( !add_tokens.empty() ){
+      result += "+" + TiCC::basename( add_tokens );
+    }
+    return result + ".bin";
+  }
+
+  bool Setting::save_compiled( const string& fname ) const {
+    /// store the fully resolved settings in a binary file
+    /*!
+      \param fname the file to create
+      \return true on succes
+
+      The file is written under a temporary name first and then renamed,
+      so other processes never see a partial file.
+    */
+    if ( source_files.empty() ){
+      return false;
+    }
+    string tmp_name = fname + "." + to_string( getpid() );
+    ofstream os( tmp_name, ios::binary );
+    if ( !os ){
+      return false;
+    }
+    BinWriter out( os );
+    os.write( MAGIC, sizeof(MAGIC) );
+    out.u32( FORMAT_VERSION );
+    out.u32( ENDIAN_MARK );
+    out.str( VERSION );
+    out.str( icu_version() );
+    out.str( add_tokens_file );
+    out.u32( source_files.size() );
+    for ( const auto& file : source_files ){
+      out.str( file );
+    }
+    out.str( version );
+    out.ustr( eosmarkers );
+    out.u32( quotes.get_quotes().size() );
+    for ( const auto& q : quotes.get_quotes() ){
+      out.ustr( q.openQuote );
+      out.ustr( q.closeQuote );
+    }
+    out.u32( filter_lines.size() );
+    for ( const auto& line : filter_lines ){
+      out.ustr( line );
+    }
+    out.u32( rules.size() );
+    for ( const auto& rule : rules ){
+      out.ustr( rule->id );
+      out.ustr( rule->pattern );
+    }
+    out.u32( rules_index.size() );
+    for ( const auto& it : rules_index ){
+      out.ustr( it.first );
+      out.u32( it.second );
+    }
+    out.u32( ruleset.get_classes().size() );
+    for ( const auto& cls : ruleset.get_classes() ){
+      out.u32( cls.getRangeCount() );
+      for ( int32_t i=0; i < cls.getRangeCount(); ++i ){
+	out.u32( cls.getRangeStart( i ) );
+	out.u32( cls.getRangeEnd( i ) );
+      }
+    }
+    out.u32( ruleset.get_required().size() );
+    for ( size_t i=0; i < ruleset.get_required().size(); ++i ){
+      out.mask( ruleset.get_required()[i] );
+      out.mask( ruleset.get_required_first()[i] );
+    }
+    os.close();
+    if ( !os
+	 || rename( tmp_name.c_str(), fname.c_str() ) != 0 ){
+      remove( tmp_name.c_str() );
+      return false;
+    }
+    return true;
+  }
+
+  bool Setting::load_compiled( const string& fname,
+			       const string& conffile,
+			       const string& add_tokens ){
+    /// try to fill this Setting from a compiled settings file
+    /*!
+      \param fname the compiled file
+      \param conffile the settingsfile it should be compiled from
+      \param add_tokens the file with additional TOKENS, if any
+      \return true when succesful. false when the file is missing, stale,
+      or doesn't match.
+
+      The file is only used when it is newer than the settingsfile and all
+      files it includes, and was made with the same ICU and Unicode versions.
+    */
+    MappedFile compiled;
+    if ( !compiled.open( fname ) ){
+      return false;
+    }
+    string reason;
+    try {
+      BinReader in( compiled.data, compiled.size );
+      char magic[sizeof(MAGIC)];
+      in.raw( magic, sizeof(magic) );
+      if ( memcmp( magic, MAGIC, sizeof(MAGIC) ) != 0
+	   || in.u32() != FORMAT_VERSION
+	   || in.u32() != ENDIAN_MARK
+	   || in.str() != VERSION
+	   || in.str() != icu_version() ){
+	throw runtime_error( "wrong format or version" );
+      }
+      string tokens_file = in.str();
+      if ( tokens_file != ( add_tokens.empty() ? "" : full_path( add_tokens ) ) ){
+	throw runtime_error( "compiled for other additional tokens" );
+      }
+      vector<string> sources( in.count() );
+      for ( auto& file : sources ){
+	file = in.str();
+	struct stat src;
+	if ( stat( file.c_str(), &src ) != 0
+	     || src.st_mtime >= compiled.mtime ){
+	  throw runtime_error( "outdated by " + file );
+	}
+      }
+      if ( sources.empty()
+	   || sources.front() != full_path( conffile ) ){
+	throw runtime_error( "compiled from another settingsfile" );
+      }
+      string data_version = in.str();
+      UnicodeString eos = in.ustr();
+      Quoting quots;
+      for ( uint32_t n = in.count(); n > 0; --n ){
+	UnicodeString open_quote = in.ustr();
+	quots.add( open_quote, in.ustr() );
+      }
+      vector<UnicodeString> filters( in.count() );
+      for ( auto& line : filters ){
+	line = in.ustr();
+      }
+      vector<unique_ptr<Rule>> new_rules( in.count() );
+      for ( auto& rule : new_rules ){
+	UnicodeString id = in.ustr();
+	rule.reset( new Rule( id, in.ustr() ) );
+      }
+      map<UnicodeString, int> index;
+      for ( uint32_t n = in.count(); n > 0; --n ){
+	UnicodeString id = in.ustr();
+	index[id] = in.u32();
+      }
+      vector<UnicodeSet> classes( in.count() );
+      for ( auto& cls : classes ){
+	for ( uint32_t n = in.count(); n > 0; --n ){
+	  UChar32 start = in.u32();
+	  cls.add( start, in.u32() );
+	}
+      }
+      vector<RuleSet::ClassMask> required( in.count() );
+      vector<RuleSet::ClassMask> required_first( required.size() );
+      for ( size_t i=0; i < required.size(); ++i ){
+	required[i] = in.mask();
+	required_first[i] = in.mask();
+      }
+      if ( !in.at_end() ){
+	throw runtime_error( "trailing garbage" );
+      }
+      // all is well, now fill in the blanks
+      ruleset.restore( classes, required, required_first );
+      for ( auto& rule : new_rules ){
+	rules.push_back( rule.release() );
+      }
+      rules_index = index;
+      for ( const auto& line : filters ){
+	filter.add( line );
+      }
+      filter_lines = filters;
+      quotes = quots;
+      eosmarkers = eos;
+      version = data_version;
+      source_files = sources;
+      add_tokens_file = tokens_file;
+    }
+    catch ( const exception& e ){
+      reason = e.what();
+    }
+    if ( !reason.empty() ){
+      if ( tokDebug ){
+	DBG << "not using compiled settings " << fname << ": "
+	    << reason << endl;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  shared_ptr<const Setting> Setting::acquire( const string& settings_name,
+					     const string& add_tokens,
+					     int dbg,
+					     TiCC::LogStream* ls,
+					     TiCC::LogStream* ds ){
+    /// get the Setting for a settingsfile, reading it only when needed
+    /*!
+      \param settings_name the settingsfile
+      \param add_tokens a file with additional TOKENS, may be empty
+      \param dbg the debug level
+      \param ls the stream for messages while reading
+      \param ds the stream for debug output while reading
+      \return the Setting, or 0 when it can't be read
+
+      A Setting is shared read-only by all Tokenizers in the process that
+      use the same (resolved) settingsfile and additional tokens. It is
+      handed out again as long as all the files it was read from keep
+      the same contents, and is deleted when its last user is gone.
+    */
+    string key = settings_name + "\n"
+      + full_path( get_filename( settings_name ) ) + "\n"
+      + ( add_tokens.empty() ? "" : full_path( add_tokens ) );
+    shared_ptr<SharedSetting> entry;
+    {
+      SettingRegistry& registry = setting_registry();
+      lock_guard<mutex> lock( registry.lock );
+      shared_ptr<SharedSetting>& known = registry.entries[key];
+      if ( !known ){
+	known = make_shared<SharedSetting>();
+      }
+      entry = known;
+    }
+    // reading another settingsfile meanwhile is fine, reading this one
+    // twice is not
+    lock_guard<mutex> lock( entry->lock );
+    shared_ptr<const Setting> result = entry->setting.lock();
+    if ( result
+	 && content_hashes( result->source_files ) == entry->hashes ){
+      if ( dbg ){
+	*TiCC::Log(ds) << "sharing the settings of " << settings_name << endl;
+      }
+      return result;
+    }
+    // not make_shared(): the registry would keep its memory alive
+    shared_ptr<Setting> set( new Setting() );
+    if ( !set->read( settings_name, add_tokens, dbg, ls, ds ) ){
+      return 0;
+    }
+    set->theErrLog = 0;
+    set->theDbgLog = 0;
+    entry->hashes = content_hashes( set->source_files );
+    entry->setting = set;
+    return set;
+  }
+
+  string Setting::read_version( const string& settings_name ){
+    /// get the version of a settingsfile, without reading all of it
+    /*!
+      \param settings_name the settingsfile
+      \return the version, as read() would find it. Empty when there is none
+    */
+    string result;
+    ifstream f( get_filename( settings_name ) );
+    string rawline;
+    while ( getline( f, rawline ) ){
+      if ( rawline.find( "%include" ) != string::npos
+	   || rawline.find( "%define" ) != string::npos
+	   || rawline.find( "SPLITTER=" ) != string::npos ){
+	continue;
+      }
+      UnicodeString line = TiCC::UnicodeFromUTF8(rawline);
+      line.trim();
+      if ( line.length() > 0 && line[0] != '#' ){
+	if ( line[0] == '[' ){
+	  // the version is only looked for before the first section
+	  break;
+	}
+	vector<string> parts = TiCC::split_at( rawline, "=" );
+	if ( parts.size() == 2 && parts[0] == "version" ){
+	  result = parts[1];
+	}
+      }
+    }
+    return result;
+  }
+
+  LazySetting::LazySetting( const shared_ptr<const Setting>& set ):
+    settings_name( set->set_file ),
+    add_tokens( set->add_tokens_file ),
+    setting( set ),
+    ptr( set.get() ),
+    failed( false )
+  {
+    /// wrap a Setting that is read already
+  }
+
+  const Setting *LazySetting::get( int dbg,
+				   TiCC::LogStream *ls,
+				   TiCC::LogStream *ds ) const {
+    /// get the Setting, and read it when this is the first time
+    /*!
+      \param dbg the debug level
+      \param ls the stream for messages while reading
+      \param ds the stream for debug output while reading
+      \return the Setting, or 0 when it can't be read
+    */
+    const Setting *result = ptr.load( memory_order_acquire );
+    if ( result ){
+      return result;
+    }
+    lock_guard<mutex> guard( lock );
+    if ( !setting && !failed ){
+      if ( dbg ){
+	*TiCC::Log(ds) << "reading settings " << settings_name
+		       << " on first use" << endl;
+      }
+      setting = Setting::acquire( settings_name, add_tokens, dbg, ls, ds );
+      if ( setting ){
+	ptr.store( setting.get(), memory_order_release );
+      }
+      else {
+	failed = true;
+	*TiCC::Log(ls) << "problem reading datafile: " << settings_name << endl;
+      }
+    }
+    return setting.get();
+  }
+
+  string LazySetting::version() const {
+    /// the version of the Setting, without reading all of it when possible
+    const Setting *set = peek();
+    return set ? set->version : Setting::read_version( settings_name );
+  }
+
   bool Setting::read( const string& settings_name,
 		      const string& add_tokens,
 		      int dbg,
@@ -605,14 +1272,10 @@ namespace Tokenizer {
     theErrLog = ls;
     theDbgLog = ds;
     splitter = "%";
-    map<ConfigMode, UnicodeString> patterns = { { ABBREVIATIONS, "" },
-						{ TOKENS, "" },
-						{ PREFIXES, "" },
-						{ SUFFIXES, "" },
-						{ ATTACHEDPREFIXES, "" },
-						{ ATTACHEDSUFFIXES, "" },
-						{ UNITS, "" },
-						{ ORDINALS, "" } };
+    // the entries of the list sections, like [TOKENS]
+    map<ConfigMode, vector<UnicodeString>> patterns;
+    // and their compiled versions, as used in the META-RULES
+    map<ConfigMode, UnicodeString> compiled_patterns;
     string conffile = get_filename( settings_name );
 
     string customconfdir = TiCC::dirname(settings_name);
@@ -635,11 +1298,25 @@ namespace Tokenizer {
     if ( !f ){
       return false;
     }
+    else if ( load_compiled( compiled_name( conffile, add_tokens ),
+			     conffile,
+			     add_tokens ) ){
+      set_file = settings_name;
+      if ( tokDebug ){
+	DBG << "using compiled settings: "
+	    << compiled_name( conffile, add_tokens ) << endl;
+      }
+    }
     else {
       vector<string> meta_rules;
       vector<UnicodeString> rules_order;
       ConfigMode mode = NONE;
       set_file = settings_name;
+      source_files.push_back( full_path( conffile ) );
+      if ( !add_tokens.empty() ){
+	add_tokens_file = full_path( add_tokens );
+	source_files.push_back( add_tokens_file );
+      }
       if ( tokDebug ){
 	DBG << "config file=" << conffile << endl;
       }
@@ -654,6 +1331,7 @@ namespace Tokenizer {
 	      file += ".rule";
 	    }
 	    file = get_filename( file, customconfdir);
+	    source_files.push_back( full_path( file ) );
 	    if ( !read_rules( file ) ){
 	      throw uConfigError( "'" + rawline + "' failed", set_file );
 	    }
@@ -664,6 +1342,7 @@ namespace Tokenizer {
 	      file += ".filter";
 	    }
 	    file = get_filename( file, customconfdir );
+	    source_files.push_back( full_path( file ) );
 	    if ( !read_filters( file ) ){
 	      throw uConfigError( "'" + rawline + "' failed", set_file );
 	    }
@@ -674,6 +1353,7 @@ namespace Tokenizer {
 	      file += ".quote";
 	    }
 	    file = get_filename( file, customconfdir );
+	    source_files.push_back( full_path( file ) );
 	    if ( !read_quotes( file ) ){
 	      throw uConfigError( "'" + rawline + "' failed", set_file );
 	    }
@@ -684,6 +1364,7 @@ namespace Tokenizer {
 	      file += ".eos";
 	    }
 	    file = get_filename( file, customconfdir);
+	    source_files.push_back( full_path( file ) );
 	    if ( !read_eosmarkers( file ) ){
 	      throw uConfigError( "'" + rawline + "' failed", set_file );
 	    }
@@ -694,6 +1375,7 @@ namespace Tokenizer {
 	      file += ".abr";
 	    }
 	    file = get_filename( file, customconfdir );
+	    source_files.push_back( full_path( file ) );
 	    if ( !read_abbreviations( file, patterns[ABBREVIATIONS] ) ){
 	      throw uConfigError( "'" + rawline + "' failed", set_file );
 	    }
@@ -775,9 +1457,7 @@ namespace Tokenizer {
 	    case CURRENCY:
 	    case UNITS:
 	    case ORDINALS:
-	      if ( !patterns[mode].isEmpty() )
-		patterns[mode] += '|';
-	      patterns[mode] += line;
+	      patterns[mode].push_back( line );
 	      break;
 	    case EOSMARKERS:
 	      if ( ( line.startsWith("\\u") && line.length() == 6 ) ||
@@ -814,6 +1494,7 @@ namespace Tokenizer {
 	      break;
 	    case FILTER:
 	      filter.add( line );
+	      filter_lines.push_back( line );
 	      break;
 	    case NONE: {
 	      vector<string> parts = TiCC::split_at( rawline, "=" );
@@ -849,10 +1530,7 @@ namespace Tokenizer {
 	  UnicodeString entry = TiCC::UnicodeFromUTF8(line);
 	  entry = escape_regex( entry );
 	  if ( !entry.isEmpty() ){
-	    if ( !patterns[TOKENS].isEmpty() ){
-	      patterns[TOKENS] += '|';
-	    }
-	    patterns[TOKENS] += entry;
+	    patterns[TOKENS].push_back( entry );
 	  }
 	}
       }
@@ -909,10 +1587,21 @@ namespace Tokenizer {
 	  case CURRENCY:
 	  case PREFIXES:
 	  case SUFFIXES:
-	    if ( !patterns[local_mode].isEmpty()){
-	      UnicodeString val = substitute_macros( patterns[local_mode],
-						     macros );
-	      new_parts.push_back( val );
+	    if ( !patterns[local_mode].empty() ){
+	      auto it = compiled_patterns.find( local_mode );
+	      if ( it == compiled_patterns.end() ){
+		vector<UnicodeString> entries;
+		for ( const auto& entry : patterns[local_mode] ){
+		  entries.push_back( substitute_macros( entry, macros ) );
+		}
+		UnicodeString val = compile_list( entries );
+		if ( tokDebug > 5 ){
+		  DBG << "compiled " << meta << " list of " << entries.size()
+		      << " entries into: " << val << endl;
+		}
+		it = compiled_patterns.insert( make_pair( local_mode, val ) ).first;
+	      }
+	      new_parts.push_back( it->second );
 	    }
 	    else {
 	      undef_parts.push_back( meta );
@@ -937,7 +1626,9 @@ namespace Tokenizer {
 	}
       }
       sort_rules( rulesmap, rules_order );
+      ruleset.compile( rules, tokDebug, theDbgLog );
     }
+    filter_table.compile( filter, filter_lines );
     int major = -1;
     int minor = -1;
     if ( !version.empty() ){
@@ -36,6 +36,12 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "config.h"
 #include "unicode/schriter.h"
 #include "unicode/ucnv.h"
@@ -80,6 +86,11 @@ namespace Tokenizer {
 
   const UChar32 ZWJ = u'\u200D';
 
+  const size_t DEFAULT_WORD_CACHE_SIZE = 10000;
+
+  // the last config_serial handed out
+  atomic<uint64_t> last_config_serial( 0 );
+
   const string ISO_SET = "http://raw.github.com/proycon/folia/master/setdefinitions/iso639_3.foliaset.ttl";
 
   const string UCTO_SET_PREFIX = "https://raw.githubusercontent.com/LanguageMachines/uctodata/master/setdefinitions/";
@@ -99,11 +110,6 @@ namespace Tokenizer {
     explicit uLogicError( const string& s ): logic_error( "ucto: logic error:" + s ){};
   };
 
-  class uCodingError: public std::runtime_error {
-  public:
-    explicit uCodingError( const string& s ): runtime_error( "ucto: coding problem:" + s ){};
-  };
-
   bool TokenizerClass::setLangDetection( bool what ){
     /// set the doDetectLang option
     /*!
@@ -125,6 +131,10 @@ namespace Tokenizer {
 			 const string& inputEncoding ){
     UnicodeString result;
     if ( !line.empty() ){
+      if ( ucnv_compareNames( inputEncoding.c_str(), "UTF-8" ) == 0 ){
+	// no need to open a converter
+	return UnicodeString::fromUTF8( line );
+      }
       try {
 	result = UnicodeString( line.c_str(),
 				line.length(),
@@ -167,37 +177,66 @@ namespace Tokenizer {
     return result;
   }
 
+  // All Tokens share these tables. They only grow, so the Symbols
+  // stay valid, also when a tokenizer is deleted.
+  SymbolTable<UnicodeString,UnicodeHash>& type_table(){
+    static SymbolTable<UnicodeString,UnicodeHash> table;
+    return table;
+  }
+
+  SymbolTable<string>& language_table(){
+    static SymbolTable<string> table;
+    return table;
+  }
+
+  Symbol Token::intern_type( const UnicodeString& type ){
+    return type_table().intern( type );
+  }
+
+  Symbol Token::intern_language( const string& lang ){
+    return language_table().intern( lang );
+  }
+
+  const Symbol no_language = Token::intern_language( "" );
+  const Symbol default_language_symbol = Token::intern_language( "default" );
+  const Symbol unknown_symbol = Token::intern_type( type_unknown );
+
   Token::Token( const UnicodeString& _type,
 		const UnicodeString& _s,
 		TokenRole _role,
 		const string& _lang_code ):
-    type(_type), role(_role), lang_code(_lang_code) {
-    if ( keep_quoted_spaces ){
-      us = filter_ZCARON( _s );
-    }
-    else {
-      us = _s;
-    }
+    Token( _type, _s, _role, intern_language( _lang_code ) )
+  {
   }
 
   Token::Token( const UnicodeString& _type,
 		const UnicodeString& _s,
 		const string& _lang_code ):
-    type(_type), role(NOROLE), lang_code(_lang_code) {
-    if ( keep_quoted_spaces ){
-      us = filter_ZCARON( _s );
-    }
-    else {
-      us = _s;
-    }
+    Token( _type, _s, NOROLE, intern_language( _lang_code ) )
+  {
   }
 
+  Token::Token( const UnicodeString& _type,
+		const UnicodeString& _s,
+		TokenRole _role,
+		Symbol _lang_code ):
+    us(_s), role(_role), _type( intern_type( _type ) ), _lang(_lang_code) {
+  }
+
+  const UnicodeString& Token::type() const {
+    return type_table().str( _type );
+  }
+
+  const string& Token::lang_code() const {
+    return language_table().str( _lang );
+  }
 
   std::string Token::texttostring() const { return TiCC::UnicodeToUTF8(us); }
-  std::string Token::typetostring() const { return TiCC::UnicodeToUTF8(type); }
+  std::string Token::typetostring() const { return TiCC::UnicodeToUTF8(type()); }
 
   ostream& operator<< (std::ostream& os, const Token& t ){
-    os << t.type << " : " << t.role  << ": '" << t.us << "' (" << t.lang_code << ")";
+    os << t.type() << " : " << t.role  << ": '" << t.us << "' ("
+       << t.lang_code() << ")";
     return os;
   }
 
@@ -224,16 +263,50 @@ namespace Tokenizer {
     return result;
   }
 
+  const string& role_string( TokenRole role ){
+    /// the UTF-8 text of a TokenRole, as toUString() gives it
+    /*!
+      \param role the role
+      \return a string for every combination of roles that is printed,
+      made only once
+    */
+    static const vector<string> texts = [](){
+      vector<string> result( ENDQUOTE*2 );
+      for ( size_t i=0; i < result.size(); ++i ){
+	result[i] = TiCC::UnicodeToUTF8( toUString( (TokenRole)i ) );
+      }
+      return result;
+    }();
+    return texts[role & ( ENDQUOTE*2 - 1 )];
+  }
+
   ostream& operator<<( ostream& os, const TokenRole& tok ){
     os << toUString( tok );
     return os;
   }
 
   bool TokenizerClass::initialize_textcat(){
-#ifdef HAVE_TEXTCAT
+    /// set up language detection
+    /*!
+      \return false when language detection is impossible
+
+      We use our own LanguageIdentifier, on the languages we are initialized
+      with, and only fall back to TextCat when that doesn't work out.
+      Before init() those languages aren't known yet, so then we only check
+      for a textcat.cfg.
+
+      A session never sets up anything: it only uses what its owner set up
+      in init(), as it owns nothing it could clean up.
+    */
+    if ( lang_id ){
+      return true;
+    }
     if ( text_cat ){
       return text_cat != NEVERLAND;
     }
+    if ( config_owner ){
+      return false;
+    }
     const char *homedir = getenv("HOME") ? getenv("HOME") : getpwuid(getuid())->pw_dir; //never NULL
     assert( homedir != NULL );
     const char *xdgconfighome = getenv("XDG_CONFIG_HOME"); //may be NULL
@@ -245,46 +318,150 @@ namespace Tokenizer {
         textcat_cfg = string(SYSCONF_PATH) + "/ucto/textcat.cfg";
         if (!TiCC::isFile(textcat_cfg)) {
 	  LOG << "NO TEXTCAT SUPPORT DUE TO MISSING textcat.cfg!" << endl;
-	  textcat_cfg = "";
+	  text_cat = NEVERLAND; // signal invalidity
+	  return false;
         }
     }
-    if (!textcat_cfg.empty()) {
-      text_cat = new TextCat( textcat_cfg, theErrLog );
-      LOG << " textcat configured from: " << textcat_cfg << endl;
+    if ( settings.empty() ){
+      // not initialized yet
+      return true;
     }
-    else {
-      text_cat = NEVERLAND; // signal invalidity
-      return false;
+    vector<string> languages;
+    if ( !und_language ){
+      // with 'und', the languages we don't support must be recognized too,
+      // to leave them undetermined. Otherwise only ours matter
+      for ( const auto& it : settings ){
+	if ( it.first != "default" ){
+	  languages.push_back( it.first );
+	}
+      }
     }
-    //    text_cat->set_debug( true );
-    // ifstream is( textcat_cfg );
-    // string line;
-    // while ( getline( is, line ) ){
-    //   LOG << line << endl;
-    //   vector<string> v = TiCC::split( line );
-    //   if ( v.size()==2 && v[1] == "nld" ){
-    // 	LOG << "voor nederlands: " << endl;
-    //     ifstream is2( v[0] );
-    // 	string line2;
-    // 	while ( getline( is2, line2 ) ){
-    // 	  LOG << line2 << endl;
-    // 	  break;
-    // 	}
-    // 	LOG << "   done with nederlands" << endl;
-    //   }
-    // }
+    try {
+      auto id = make_shared<const LanguageIdentifier>( textcat_cfg,
+						       languages,
+						       theErrLog,
+						       tokDebug ? theDbgLog : 0 );
+      if ( id->isInit() ){
+	lang_id = id;
+	LOG << " language identification configured from: " << textcat_cfg
+	    << ( lang_id->from_compiled() ? " (compiled)" : "" ) << endl;
+	if ( tokDebug ){
+	  DBG << "identifying the languages: " << lang_id->languages() << endl;
+	}
+	return true;
+      }
+    }
+    catch ( const exception& e ){
+      LOG << "language identification failed: " << e.what() << endl;
+    }
+#ifdef HAVE_TEXTCAT
+    text_cat = new TextCat( textcat_cfg, theErrLog );
+    LOG << " textcat configured from: " << textcat_cfg << endl;
     return true;
 #else
     LOG << "NO TEXTCAT SUPPORT!" << endl;
+    text_cat = NEVERLAND;
     return false;
 #endif
   }
 
+  WordCache::WordCache( size_t cap ):
+    _capacity( cap ),
+    _hits( 0 ),
+    _misses( 0 )
+  {
+  }
+
+  size_t WordCache::set_capacity( size_t cap ){
+    /// set the maximum number of entries
+    /*!
+      \param cap the new capacity. 0 disables the cache
+      \return the old capacity
+    */
+    size_t old = _capacity;
+    _capacity = cap;
+    trim( _capacity );
+    return old;
+  }
+
+  void WordCache::clear(){
+    /// remove all entries, f.e. after a change of the configuration
+    lookup.clear();
+    entries.clear();
+  }
+
+  void WordCache::trim( size_t max ){
+    /// drop the least recently used entries, until max are left
+    while ( lookup.size() > max ){
+      lookup.erase( entries.back().first );
+      entries.pop_back();
+    }
+  }
+
+  const WordCache::Entry *WordCache::find( Symbol lang,
+					   const UnicodeString& word,
+					   int flags ){
+    /// lookup a word in the cache
+    /*!
+      \param lang the language the word is tokenized in
+      \param word the word
+      \param flags the settings that influence the tokenization
+      \return the cached Entry, or 0 when not found
+    */
+    auto it = lookup.find( Key{ lang, word, flags } );
+    if ( it == lookup.end() ){
+      ++_misses;
+      return 0;
+    }
+    ++_hits;
+    // move it to the front
+    entries.splice( entries.begin(), entries, it->second );
+    return &it->second->second;
+  }
+
+  void WordCache::insert( Symbol lang,
+			  const UnicodeString& word,
+			  int flags,
+			  const Entry& entry ){
+    /// add a word to the cache, dropping the least recently used one when
+    /// the cache is full
+    /*!
+      \param lang the language the word is tokenized in
+      \param word the word
+      \param flags the settings that influence the tokenization
+      \param entry the result of the tokenization
+    */
+    if ( _capacity == 0 ){
+      return;
+    }
+    Key key{ lang, word, flags };
+    if ( lookup.find( key ) != lookup.end() ){
+      return;
+    }
+    trim( _capacity - 1 );
+    entries.push_front( make_pair( key, entry ) );
+    lookup[key] = entries.begin();
+  }
+
   TokenizerClass::TokenizerClass():
     linenum(0),
+    config_owner(0),
+    config_serial( ++last_config_serial ),
+    quick_normalizer( find_normalizer( normalizer.getMode() ) ),
     inputEncoding( "UTF-8" ),
+    replace_invalid(true),
+    pipeline(false),
+    chunk_lines(0),
+    chunk_pos(0),
+    line_queue(0),
+    block_pos(0),
+    bad_pos(0),
     space_separated(true),
+    char_table( make_shared<CharTable>() ),
+    keep_quoted_spaces(Tokenizer::keep_quoted_spaces),
     utt_mark("<utt>"),
+    word_cache( DEFAULT_WORD_CACHE_SIZE ),
+    profile_rules(false),
     und_language(false),
     tokDebug(0),
     verbose(false),
@@ -317,21 +494,15 @@ namespace Tokenizer {
     theErrLog->set_message( "ucto" );
     theDbgLog = theErrLog;
     theErrLog->set_stamp( StampMessage );
+    restart_scan();
   }
 
   TokenizerClass::~TokenizerClass(){
-    Setting *d = 0;
-    for ( const auto& s : settings ){
-      if ( s.first == "default" ){
-	// the 'default' may also return as a real 'language'
-	// avoid deleting it twice
-	d = s.second;
-	delete d;
-      }
-      if ( s.second != d ){
-	delete s.second;
-      }
-
+    // before the settings, the patterns of their rules may go with them
+    rule_matchers.clear();
+    if ( config_owner ){
+      // a session, nothing is ours
+      return;
     }
     if ( theDbgLog != theErrLog ){
       delete theDbgLog;
@@ -342,13 +513,30 @@ namespace Tokenizer {
     }
   }
 
-  bool TokenizerClass::reset( const string& lang ){
+  bool TokenizerClass::reset( const string& ){
+    /// forget everything about the input seen so far
+    /*!
+      After this, the tokenizer can be used for a new document, just
+      like a freshly initialized one. The quote stacks of all languages
+      are cleared, not only the one of the language given, as the next
+      document may use any of them. The line number and the paragraph
+      state start over as well.
+
+      The configuration, the document ID and the word cache are kept,
+      which is what makes this so much cheaper than a new init().
+    */
     ucto_processor = 0;
     already_tokenized = false;
+    document_language.clear();
     tokens.clear();
-    if ( settings.find(lang) != settings.end() ){
-      settings[lang]->quotes.clearStack();
-    }
+    restart_scan();
+    input_decoder.reset();
+    chunk_lines = 0;
+    line_queue = 0;
+    linenum = 0;
+    paragraphsignal = true;
+    paragraphsignal_next = false;
+    quote_stacks.clear();
     return true;
   }
 
@@ -363,6 +551,8 @@ namespace Tokenizer {
     for ( const auto& val : parts ){
       norm_set.insert( TiCC::UnicodeFromUTF8( val ) );
     }
+    word_cache.clear();
+    config_serial = ++last_config_serial;
     return true;
   }
 
@@ -458,6 +648,18 @@ namespace Tokenizer {
 	  }
 	}
       }
+      // a session may still use the old table
+      shared_ptr<CharTable> table = make_shared<CharTable>( *char_table );
+      if ( space_separated ){
+	table->reset( CharTable::SEPARATOR );
+      }
+      else {
+	table->remove( CharTable::SEPARATOR );
+      }
+      for ( const auto& sep : separators ){
+	table->add( sep, CharTable::SEPARATOR );
+      }
+      char_table = table;
     }
     return TiCC::UnicodeToUTF8(prev);
   }
@@ -504,11 +706,15 @@ namespace Tokenizer {
       \param b a boolean used to signal set/unset
       \return the old value
 
-      Also makes sure TextCat is initialized
+      Also makes sure language detection is initialized. Our own
+      LanguageIdentifier has no debugging, so then this does nothing
     */
-    if ( !text_cat ){
+    if ( !text_cat && !lang_id ){
       initialize_textcat();
     }
+    if ( lang_id || !text_cat ){
+      return false;
+    }
     if ( text_cat == NEVERLAND ){
       throw logic_error( "attempt to set debug on uninitialized TextClass object" );
     }
@@ -517,31 +723,6 @@ namespace Tokenizer {
     }
   }
 
-  string fixup_UTF16( const string& input_line, const string& encoding ){
-    string line = input_line;
-    // some hackery to handle exotic input. UTF-16 but also CR at end.
-    string::size_type pos = line.rfind( '\r' );
-    if ( pos != string::npos ){
-      line.erase( pos );
-    }
-    if ( line.size() > 0 && line[0] == 0 ){
-      // when processing UTF16LE, '0' bytes show up at pos 0
-      // we discard them, not for UTF16BE!
-      // this works on Linux with GCC (atm)
-      if ( encoding != "UTF16BE" ){
-	line.erase(0,1);
-      }
-    }
-    if ( line.size() > 0 && encoding == "UTF16BE" &&
-	 line.back() == 0 ){
-      // when processing UTF16BE, '0' bytes show up at the end
-      // we discard them.
-      // this works on Linux with GCC (atm)
-      line.erase(line.size()-1);
-    }
-    return line;
-  }
-
   folia::processor *TokenizerClass::init_provenance( folia::Document *doc,
 						     folia::processor *parent ) const {
     if ( ucto_processor ){
@@ -721,10 +902,10 @@ namespace Tokenizer {
 	  continue;
 	}
 	folia::KWargs args;
-	args["name"] = s.second->set_file;
+	args["name"] = s.second->name();
 	args["generate_id"] = "next()";
 	args["type"] = "datasource";
-	args["version"] = s.second->version;
+	args["version"] = s.second->version();
 	doc->add_processor( args, data_proc );
 	args.clear();
 	args["processor"] = proc->id();
@@ -772,22 +953,37 @@ namespace Tokenizer {
     return doc;
   }
 
-#ifdef HAVE_TEXTCAT
   string TokenizerClass::detect( const UnicodeString& line ) {
-    if ( text_cat == 0 ){
+    if ( !lang_id && text_cat == 0 ){
       initialize_textcat();
     }
-    if ( text_cat == NEVERLAND ){
+    if ( !lang_id && ( text_cat == 0 || text_cat == NEVERLAND ) ){
+#ifdef HAVE_TEXTCAT
       return "";
+#else
+      LOG << "No TextCat support available" << endl;
+      return "default";
+#endif
     }
     UnicodeString temp = line;
     temp.findAndReplace( utt_mark, "" );
     temp.toLower();
-    if ( tokDebug > 3 ){
-      DBG << "use textCat to guess language from: "
-	  << temp << endl;
+    string language;
+    if ( lang_id ){
+      if ( tokDebug > 3 ){
+	DBG << "guess language from: " << temp << endl;
+      }
+      language = lang_id->get_language( temp );
     }
-    string language = text_cat->get_language( TiCC::UnicodeToUTF8(temp) );
+#ifdef HAVE_TEXTCAT
+    else {
+      if ( tokDebug > 3 ){
+	DBG << "use textCat to guess language from: "
+	    << temp << endl;
+      }
+      language = text_cat->get_language( TiCC::UnicodeToUTF8(temp) );
+    }
+#endif
     string result;
     if ( settings.find( language ) != settings.end() ){
       if ( tokDebug > 4 ){
@@ -808,18 +1004,12 @@ namespace Tokenizer {
     }
     return result;
   }
-#else
-  string TokenizerClass::detect( const UnicodeString& ) {
-    LOG << "No TextCat support available" << endl;
-    return "default";
-  }
-#endif
 
   vector<UnicodeString> TokenizerClass::sentence_split( const UnicodeString& in ){
     /// split a UnicodeString on the standard EOS markers,
     //  but ONLY when followed by a space. otherwise keep together
     set<int> eos_posses;
-    UnicodeString EOSM = settings["default"]->eosmarkers;
+    UnicodeString EOSM = get_setting( "default" )->eosmarkers;
     // first we collect al the positions of EOS markers
     for ( int i=0; i < EOSM.length(); ++i ){
       int pos = in.indexOf( EOSM[i] );
@@ -862,7 +1052,9 @@ namespace Tokenizer {
       As the Unicodestring can be of dubious heritage, we normalize
       it before further use
     */
-    UnicodeString input_line = normalizer.normalize( _input );
+    // only the last token we already have may change
+    scan_changed( tokens.empty() ? 0 : tokens.size()-1 );
+    const UnicodeString& input_line = normalize_line( _input );
     if ( passthru ){
       passthruLine( input_line, bos );
       return;
@@ -921,6 +1113,9 @@ namespace Tokenizer {
 	string lan = part.first;
 	if ( lan == "und" ){
 	  tokens.push_back( Token( type_unanalyzed, part.second, "und" ) );
+	  if ( keep_quoted_spaces ){
+	    unmark_quoted_spaces( tokens.size() - 1 );
+	  }
 	  tokens.back().role |= BEGINOFSENTENCE;
 	  tokens.back().role |= ENDOFSENTENCE;
 	}
@@ -948,7 +1143,74 @@ namespace Tokenizer {
     }
   }
 
+  bool TokenizerClass::next_line( UnicodeString& line ){
+    /// get the next line of the input
+    /*!
+      \param line the line
+      \return false at the end of the input
+
+      The lines come from the input_decoder, or from the chunk_lines or
+      the line_queue, when they are set. Lines with invalid UTF-8 are
+      reported, and maybe skipped.
+    */
+    if ( chunk_lines ){
+      if ( chunk_pos == chunk_lines->size() ){
+	return false;
+      }
+      line = (*chunk_lines)[chunk_pos++];
+      ++linenum;
+      return true;
+    }
+    if ( line_queue ){
+      while ( true ){
+	if ( block_pos == line_block.lines.size() ){
+	  if ( !line_queue->pop( line_block ) ){
+	    return false;
+	  }
+	  block_pos = 0;
+	  bad_pos = 0;
+	}
+	line = std::move( line_block.lines[block_pos] );
+	++linenum;
+	if ( bad_pos < line_block.bad.size()
+	     && line_block.bad[bad_pos].first == block_pos ){
+	  report_invalid( line_block.bad[bad_pos++].second );
+	  if ( !replace_invalid ){
+	    ++block_pos;
+	    continue;
+	  }
+	}
+	++block_pos;
+	return true;
+      }
+    }
+    while ( input_decoder->getline( line ) ){
+      ++linenum;
+      if ( !input_decoder->bad_sequences().empty() ){
+	report_invalid( input_decoder->bad_sequences() );
+	if ( !replace_invalid ){
+	  continue;
+	}
+      }
+      return true;
+    }
+    return false;
+  }
+
   vector<Token> TokenizerClass::tokenizeOneSentence( istream& IN ){
+    if ( !input_decoder
+	 || !input_decoder->reads( IN ) ){
+      open_input( IN );
+    }
+    return next_sentence();
+  }
+
+  vector<Token> TokenizerClass::next_sentence( const string& lang ){
+    /// get the next sentence, reading more lines when needed
+    /*!
+      \param lang the language of the lines. When empty, the default, or
+      the detected language is used
+    */
     if  (tokDebug > 0) {
       DBG << "[tokenizeOneSentence()] before countSent " << endl;
     }
@@ -965,24 +1227,15 @@ namespace Tokenizer {
     }
     bool done = false;
     bool bos = true;
-    inputEncoding = checkBOM( IN );
-    string line;
+    UnicodeString input_line;
     do {
-      done = !getline( IN, line );
-      UnicodeString input_line;
+      done = !next_line( input_line );
       if ( !done ){
-	++linenum;
 	if (tokDebug > 0) {
 	  DBG << "[tokenize] Read input line " << linenum
-	      << "-: '" << TiCC::format_non_printable( line ) << "'" << endl;
-	}
-	string tmp_line = fixup_UTF16( line, inputEncoding );
-	if ( tokDebug > 0
-	     && tmp_line != line ){
-	  DBG << "After fixup, input_line= '"
-	      << TiCC::format_non_printable( tmp_line ) << "'" << endl;
+	      << "-: '" << TiCC::format_non_printable( input_line ) << "'"
+	      << endl;
 	}
-	input_line = convert( tmp_line, inputEncoding );
 	if ( sentenceperlineinput ){
 	  input_line += " " + utt_mark;
 	}
@@ -997,7 +1250,7 @@ namespace Tokenizer {
 	// setting explicit END_OF_SENTENCE
       }
       else {
-	tokenize_one_line( input_line, bos );
+	tokenize_one_line( input_line, bos, lang );
 	numS = countSentences(); //count full sentences in token buffer
       }
       if ( numS > 0 ) {
@@ -1072,16 +1325,19 @@ namespace Tokenizer {
 
   folia::Document *TokenizerClass::tokenize( istream& IN ) {
     reset(); // when starting a new inputfile, we must reset provenance et.al.
-    inputEncoding = checkBOM( IN );
+    open_input( IN );
     folia::Document *doc = start_document( docid );
     folia::FoliaElement *root = doc->doc()->index(0);
     int parCount = 0;
     vector<Token> buffer;
+    vector<Token> v;
     do {
       if ( tokDebug > 0 ){
 	DBG << "[tokenize] looping on stream" << endl;
       }
-      vector<Token> v = tokenizeOneSentence( IN );
+      // the stream itself may be at its end already, while the
+      // decoder still holds some lines
+      v = tokenizeOneSentence( IN );
       if ( !v.empty() ){
 	if ( tokDebug > 1 ){
 	  DBG << "[tokenize] sentence=" << v << endl;
@@ -1089,7 +1345,7 @@ namespace Tokenizer {
 	root = append_to_folia( root, v, parCount );
       }
     }
-    while ( IN );
+    while ( !v.empty() );
     if ( tokDebug > 0 ){
       DBG << "[tokenize] end of stream reached" << endl;
     }
@@ -1180,29 +1436,33 @@ namespace Tokenizer {
 	if ( !data.empty() ){
 	  tokenizeLine( data );
 	  // extract sentence from Token vector until done
+	  OutputWriter out( OUT );
 	  vector<Token> v = popSentence();
 	  while( !v.empty() ){
-	    UnicodeString res = outputTokens( v , (i>0) );
-	    OUT << res;
+	    outputTokens( out, v , (i>0) );
 	    ++i;
 	    v = popSentence();
 	  }
+	  out.flush();
 	  OUT << endl;
 	}
       }
     }
 #endif
+    else if ( pipeline ){
+      tokenize_pipelined( IN, OUT );
+    }
     else {
       int i = 0;
-      inputEncoding = checkBOM( IN );
+      open_input( IN );
+      OutputWriter out( OUT );
       do {
 	if ( tokDebug > 0 ){
 	  DBG << "[tokenize] looping on stream" << endl;
 	}
 	vector<Token> v = tokenizeOneSentence( IN );
 	while( !v.empty() ){
-	  UnicodeString res = outputTokens( v , (i>0) );
-	  OUT << res;
+	  outputTokens( out, v , (i>0) );
 	  ++i;
 	  v = tokenizeOneSentence( IN );
 	}
@@ -1210,10 +1470,423 @@ namespace Tokenizer {
       if ( tokDebug > 0 ){
 	DBG << "[tokenize] end_of_stream" << endl;
       }
+      out.flush();
       OUT << endl;
     }
   }
 
+  // the number of characters in a LineBlock, and the number of LineBlocks
+  // and output buffers that may wait for the next thread
+  const size_t LINE_BLOCK_SIZE = 64*1024;
+  const size_t PIPELINE_DEPTH = 8;
+
+  void TokenizerClass::tokenize_pipelined( istream& IN, ostream& OUT ){
+    /// tokenize a text stream, reading and writing on other threads
+    /*!
+      \param IN the input stream
+      \param OUT the output stream
+
+      A reader thread reads and decodes the input, and passes it on in
+      LineBlocks. We tokenize them, and pass the output in large buffers
+      to a writer thread. The threads are connected by small queues which
+      need no locks. So when reading or writing stalls, tokenizing goes on
+      with the data already there, until that runs out.
+      The output is the same as without the pipeline.
+    */
+    open_input( IN );
+    SPSCQueue<LineBlock> lines( PIPELINE_DEPTH );
+    SPSCQueue<string> buffers( PIPELINE_DEPTH );
+    exception_ptr read_error;
+    thread reader( [&](){
+	try {
+	  LineBlock block;
+	  while ( input_decoder->getlines( block, LINE_BLOCK_SIZE )
+		  && lines.push( std::move( block ) ) ){
+	  }
+	}
+	catch ( ... ){
+	  read_error = current_exception();
+	}
+	lines.close();
+      } );
+    thread writer( [&](){
+	string buffer;
+	while ( buffers.pop( buffer ) ){
+	  OUT.write( buffer.data(), buffer.size() );
+	}
+      } );
+    line_queue = &lines;
+    line_block = LineBlock();
+    block_pos = 0;
+    bad_pos = 0;
+    exception_ptr error;
+    try {
+      OutputWriter out;
+      int i = 0;
+      vector<Token> v = next_sentence();
+      while( !v.empty() ){
+	outputTokens( out, v , (i>0) );
+	++i;
+	if ( out.full() ){
+	  buffers.push( out.take() );
+	}
+	v = next_sentence();
+      }
+      buffers.push( out.take() );
+    }
+    catch ( ... ){
+      error = current_exception();
+    }
+    line_queue = 0;
+    // stop the reader, if it isn't done already
+    lines.close();
+    buffers.close();
+    reader.join();
+    writer.join();
+    if ( !error ){
+      error = read_error;
+    }
+    if ( error ){
+      rethrow_exception( error );
+    }
+    OUT << endl;
+  }
+
+  // the minimal number of characters in a Chunk
+  const size_t CHUNK_SIZE = 256*1024;
+
+  bool TokenizerClass::read_chunk( vector<UnicodeString>& lines ){
+    /// read the next part of the input that can be tokenized on its own
+    /*!
+      \param lines the lines read
+      \return false at the end of the input
+
+      At an empty line all tokens seen so far are flushed, and the next
+      line starts a new paragraph, just as at the start of the input. So
+      the input can be cut after every empty line. A chunk is at least
+      CHUNK_SIZE characters, to keep the overhead small.
+    */
+    lines.clear();
+    size_t size = 0;
+    UnicodeString line;
+    while ( next_line( line ) ){
+      size += line.length();
+      lines.push_back( line );
+      if ( line.isEmpty()
+	   && size >= CHUNK_SIZE ){
+	break;
+      }
+    }
+    return !lines.empty();
+  }
+
+  void TokenizerClass::tokenize_chunk( Chunk& chunk ){
+    /// tokenize a chunk, as if it is all there is
+    /*!
+      \param chunk the Chunk. Its output is filled in
+    */
+    reset();
+    chunk_lines = &chunk.lines;
+    chunk_pos = 0;
+    OutputWriter first;
+    OutputWriter first_continued;
+    OutputWriter rest;
+    vector<Token> v = next_sentence();
+    if ( !v.empty() ){
+      // whether this is the first sentence of the output, only the
+      // caller knows
+      outputTokens( first, v, false );
+      outputTokens( first_continued, v, true );
+      v = next_sentence();
+    }
+    while( !v.empty() ){
+      outputTokens( rest, v, true );
+      v = next_sentence();
+    }
+    chunk_lines = 0;
+    chunk.first = first.str();
+    chunk.first_continued = first_continued.str();
+    chunk.rest = rest.str();
+  }
+
+  void TokenizerClass::tokenize( istream& IN, ostream& OUT,
+				 const vector<TokenizerClass*>& helpers ){
+    /// tokenize a text stream, using the helpers for the real work
+    /*!
+      \param IN the input stream
+      \param OUT the output stream
+      \param helpers the tokenizers to use, each on its own thread. They
+      must be initialized with the same settings as this one
+
+      We read the input and cut it into Chunks. Every helper takes the next
+      Chunk waiting, and tokenizes it. The results are written in the
+      original order: the Chunks that are read but not yet written form a
+      reorder buffer, which is kept small to limit the memory used.
+
+      With FoLiA output, or with one sentence per line input, where an
+      empty line doesn't end a paragraph, we just tokenize as usual.
+    */
+    if ( helpers.empty()
+	 || xmlout
+	 || sentenceperlineinput
+	 || ( &IN == &cin && isatty(0) ) ){
+      tokenize( IN, OUT );
+      return;
+    }
+    struct Slot {
+      Chunk chunk;
+      bool ready = false;
+      exception_ptr error;
+    };
+    deque<unique_ptr<Slot>> window; // read, but not written, oldest first
+    deque<Slot*> todo;              // not yet taken by a helper
+    bool finished = false;
+    mutex mtx;
+    condition_variable work_cv;
+    condition_variable done_cv;
+    auto work = [&]( TokenizerClass *helper ){
+      while ( true ){
+	Slot *slot;
+	{
+	  unique_lock<mutex> lock( mtx );
+	  work_cv.wait( lock, [&]{ return !todo.empty() || finished; } );
+	  if ( todo.empty() ){
+	    return;
+	  }
+	  slot = todo.front();
+	  todo.pop_front();
+	}
+	try {
+	  helper->tokenize_chunk( slot->chunk );
+	}
+	catch ( ... ){
+	  slot->error = current_exception();
+	}
+	{
+	  lock_guard<mutex> lock( mtx );
+	  slot->ready = true;
+	}
+	done_cv.notify_all();
+      }
+    };
+    vector<thread> pool;
+    for ( const auto& helper : helpers ){
+      pool.emplace_back( work, helper );
+    }
+    exception_ptr error;
+    try {
+      open_input( IN );
+      OutputWriter out( OUT );
+      const size_t max_window = 2 * helpers.size();
+      bool more = true;
+      bool written = false;
+      while ( true ){
+	while ( more && window.size() < max_window ){
+	  unique_ptr<Slot> slot( new Slot );
+	  more = read_chunk( slot->chunk.lines );
+	  if ( more ){
+	    {
+	      lock_guard<mutex> lock( mtx );
+	      todo.push_back( slot.get() );
+	    }
+	    window.push_back( std::move( slot ) );
+	    work_cv.notify_one();
+	  }
+	}
+	if ( window.empty() ){
+	  break;
+	}
+	Slot& head = *window.front();
+	{
+	  unique_lock<mutex> lock( mtx );
+	  done_cv.wait( lock, [&]{ return head.ready; } );
+	}
+	if ( head.error ){
+	  rethrow_exception( head.error );
+	}
+	if ( !head.chunk.first.empty() ){
+	  out.put( written ? head.chunk.first_continued : head.chunk.first );
+	  written = true;
+	}
+	out.put( head.chunk.rest );
+	out.flush_if_full();
+	window.pop_front();
+      }
+      out.flush();
+      OUT << endl;
+    }
+    catch ( ... ){
+      error = current_exception();
+    }
+    {
+      lock_guard<mutex> lock( mtx );
+      finished = true;
+      todo.clear();
+    }
+    work_cv.notify_all();
+    for ( auto& t : pool ){
+      t.join();
+    }
+    if ( error ){
+      rethrow_exception( error );
+    }
+  }
+
+  TokenizerClass::TokenizerClass( const TokenizerClass *owner ):
+    linenum(0),
+    config_owner(owner),
+    config_serial(owner->config_serial),
+    quick_normalizer(0),
+    replace_invalid(true),
+    pipeline(false),
+    chunk_lines(0),
+    chunk_pos(0),
+    line_queue(0),
+    block_pos(0),
+    bad_pos(0),
+    space_separated(true),
+    char_table( owner->char_table ),
+    keep_quoted_spaces(false),
+    word_cache( owner->word_cache.capacity() ),
+    profile_rules(false),
+    theErrLog( owner->theErrLog ),
+    theDbgLog( owner->theDbgLog ),
+    und_language(false),
+    settings( owner->settings ),
+    tokDebug(0),
+    verbose(false),
+    detectQuotes(false),
+    doFilter(true),
+    doPunctFilter(false),
+    doWordCorrection(true),
+    splitOnly( false ),
+    detectPar(true),
+    paragraphsignal(true),
+    paragraphsignal_next(false),
+    doDetectLang(false),
+    sentenceperlineoutput(false),
+    sentenceperlineinput(false),
+    copyclass(false),
+    lowercase(false),
+    uppercase(false),
+    xmlout(false),
+    xmlin(false),
+    passthru(false),
+    ignore_tag_hints(false),
+    ucto_processor(0),
+    already_tokenized(false),
+    text_cat( 0 )
+  {
+    /// create a session on the configuration of another tokenizer
+    /*!
+      \param owner the tokenizer with the configuration. It must outlive
+      the session, and it must not change meanwhile
+
+      The settings, the table of characters, the log streams and the
+      language detection are shared, all options are copied. The state of
+      the input, the rule matchers and the word cache are our own.
+    */
+    use_options( *owner );
+    restart_scan();
+  }
+
+  void TokenizerClass::use_options( const TokenizerClass& owner ){
+    /// take over the options of the owner of a session
+    /*!
+      \param owner the tokenizer with the configuration
+
+      All of these may be changed between two calls of
+      tokenize( text, options ), and are cheap to copy. A new init() gives
+      the owner another config_serial, so then we aren't used anymore.
+    */
+    theErrLog = owner.theErrLog;
+    theDbgLog = owner.theDbgLog;
+    tokDebug = owner.tokDebug;
+    if ( normalizer.getMode() != owner.normalizer.getMode() ){
+      normalizer.setMode( owner.normalizer.getMode() );
+    }
+    quick_normalizer = owner.quick_normalizer;
+    inputEncoding = owner.inputEncoding;
+    replace_invalid = owner.replace_invalid;
+    separators = owner.separators;
+    space_separated = owner.space_separated;
+    char_table = owner.char_table;
+    keep_quoted_spaces = owner.keep_quoted_spaces;
+    utt_mark = owner.utt_mark;
+    if ( word_cache.capacity() != owner.word_cache.capacity() ){
+      word_cache.set_capacity( owner.word_cache.capacity() );
+    }
+    norm_set = owner.norm_set;
+    und_language = owner.und_language;
+    default_language = owner.default_language;
+    verbose = owner.verbose;
+    detectQuotes = owner.detectQuotes;
+    doFilter = owner.doFilter;
+    doPunctFilter = owner.doPunctFilter;
+    splitOnly = owner.splitOnly;
+    detectPar = owner.detectPar;
+    doDetectLang = owner.doDetectLang;
+    sentenceperlineoutput = owner.sentenceperlineoutput;
+    sentenceperlineinput = owner.sentenceperlineinput;
+    lowercase = owner.lowercase;
+    uppercase = owner.uppercase;
+    passthru = owner.passthru;
+    ignore_tag_hints = owner.ignore_tag_hints;
+    text_cat = owner.text_cat;
+    lang_id = owner.lang_id;
+  }
+
+  vector<vector<Token>> TokenizerClass::tokenize( const UnicodeString& text,
+					       const TokenizeOptions& options ) const {
+    /// tokenize a text into sentences, without changing the tokenizer
+    /*!
+      \param text the text. It may contain several lines, an empty line
+      ends a paragraph
+      \param options the options for this text only
+      \return the sentences
+
+      All work is done in a session of our own, so this may be called from
+      many threads at the same time. Every thread keeps its session for the
+      next call, so the rule matchers and the word cache of the previous
+      calls are used again. Only when the thread works for another
+      tokenizer, or ours is initialized again, a new session is made.
+    */
+    thread_local unique_ptr<TokenizerClass> session;
+    if ( !session
+	 || session->config_owner != this
+	 || session->config_serial != config_serial ){
+      session.reset( new TokenizerClass( this ) );
+    }
+    else {
+      session->use_options( *this );
+      session->reset();
+    }
+    session->sentenceperlineinput = options.sentence_per_line;
+    vector<UnicodeString> lines;
+    int32_t pos = 0;
+    while ( pos < text.length() ){
+      int32_t nl = text.indexOf( (UChar)'\n', pos );
+      if ( nl < 0 ){
+	nl = text.length();
+      }
+      int32_t end = nl;
+      if ( end > pos && text[end-1] == '\r' ){
+	--end;
+      }
+      lines.push_back( UnicodeString( text, pos, end - pos ) );
+      pos = nl + 1;
+    }
+    session->chunk_lines = &lines;
+    session->chunk_pos = 0;
+    vector<vector<Token>> result;
+    vector<Token> sentence = session->next_sentence( options.language );
+    while ( !sentence.empty() ){
+      result.push_back( std::move( sentence ) );
+      sentence = session->next_sentence( options.language );
+    }
+    return result;
+  }
+
   void set_language( folia::FoliaElement* node, const string& lang ){
     // set the language on this @node to @lang
     // If a LangAnnotation with a set is already present, we silently
@@ -1371,7 +2044,7 @@ namespace Tokenizer {
       if ( !ids.empty() ){
 	args["generate_id"] = ids;
       }
-      args["class"] = TiCC::UnicodeToUTF8(tok.type);
+      args["class"] = TiCC::UnicodeToUTF8(tok.type());
       if ( tok.role & NOSPACE ){
 	args["space"] = "no";
       }
@@ -1531,7 +2204,7 @@ namespace Tokenizer {
       // New elements
       folia::KWargs args;
       args["xml:id"] = orig->generateId( "tokenized" );
-      args["class"] = TiCC::UnicodeToUTF8(tok.type);
+      args["class"] = TiCC::UnicodeToUTF8(tok.type());
       if ( tok.role & NOSPACE ){
 	args["space"] = "no";
       }
@@ -2012,21 +2685,21 @@ namespace Tokenizer {
     }
   }
 
-  UnicodeString TokenizerClass::outputTokens( const vector<Token>& tokens,
-					      const bool continued ) const {
+  void TokenizerClass::outputTokens( OutputWriter& out,
+				     const vector<Token>& tokens,
+				     const bool continued ) const {
     /*!
+      \param out the OutputWriter to write the tokenized lines to,
+      including token information, when verbose mode is on.
       \param tokens A list of Token's to display
       \param continued Set to true when outputTokens is invoked multiple
       times and it is not the first invokation
 
       this makes paragraph boundaries work over multiple calls
-      \return A UnicodeString representing tokenized lines, including token
-      information, when verbose mode is on.
     */
     short quotelevel = 0;
-    UnicodeString result;
     for ( const auto& token : tokens ) {
-      UnicodeString outline;
+      const size_t start = out.str().size();
       if (tokDebug >= 5){
 	DBG << "outputTokens: token=" << token << endl;
       }
@@ -2036,20 +2709,21 @@ namespace Tokenizer {
 	   && continued ) {
 	//output paragraph separator
 	if ( sentenceperlineoutput ) {
-	  outline += "\n";
+	  out.put( '\n' );
 	}
 	else {
-	  outline += "\n\n";
+	  out.put( "\n\n" );
 	}
       }
-      UnicodeString s = token.us;
       if (lowercase) {
-	s = s.toLower();
+	out.put_lower( token.us );
       }
       else if ( uppercase ) {
-	s = s.toUpper();
+	out.put_upper( token.us );
+      }
+      else {
+	out.put( token.us );
       }
-      outline += s;
       if ( token.role & NEWPARAGRAPH ) {
 	quotelevel = 0;
       }
@@ -2057,7 +2731,11 @@ namespace Tokenizer {
 	++quotelevel;
       }
       if ( verbose ) {
-	outline += "\t" + token.type + "\t" + toUString(token.role) + "\n";
+	out.put( '\t' );
+	out.put( token.type() );
+	out.put( '\t' );
+	out.put( role_string( token.role ) );
+	out.put( '\n' );
       }
       if ( token.role & ENDQUOTE ) {
 	--quotelevel;
@@ -2066,25 +2744,27 @@ namespace Tokenizer {
       if ( token.role & ENDOFSENTENCE ) {
 	if ( verbose ) {
 	  if ( !(token.role & NOSPACE ) ){
-	    outline += "\n";
+	    out.put( '\n' );
 	  }
 	}
 	else {
 	  if ( quotelevel == 0 ) {
 	    if ( sentenceperlineoutput ) {
-	      outline += "\n";
+	      out.put( '\n' );
 	    }
 	    else {
-	      outline += " " + utt_mark + " ";
+	      out.put( ' ' );
+	      out.put( utt_mark );
+	      out.put( ' ' );
 	    }
 	    if ( splitOnly ){
-	      outline += "\n";
+	      out.put( '\n' );
 	    }
 	  }
 	  else { //inside quotation
 	    if ( splitOnly
 		 && !(token.role & NOSPACE ) ){
-	      outline += " ";
+	      out.put( ' ' );
 	    }
 	  }
 	}
@@ -2099,26 +2779,94 @@ namespace Tokenizer {
 		 && (token.role & NOSPACE) ){
 	    }
 	    else {
-	      outline += " ";
+	      out.put( ' ' );
 	    }
 	  }
 	}
 	else if ( quotelevel > 0 ) {
 	  //FBK: ADD SPACE WITHIN QUOTE CONTEXT IN ANY CASE
-	  outline += " ";
+	  out.put( ' ' );
 	}
       }
       if (tokDebug >= 5){
-	DBG << "outputTokens: outline=" << outline << endl;
+	DBG << "outputTokens: outline=" << out.str().substr( start ) << endl;
       }
-      result += outline;
+      out.flush_if_full();
     }
+  }
+
+  UnicodeString TokenizerClass::outputTokens( const vector<Token>& tokens,
+					      const bool continued ) const {
+    /*!
+      \param tokens A list of Token's to display
+      \param continued Set to true when outputTokens is invoked multiple
+      times and it is not the first invokation
+      \return A UnicodeString representing tokenized lines, including token
+      information, when verbose mode is on.
+    */
+    OutputWriter out;
+    outputTokens( out, tokens, continued );
+    UnicodeString result = UnicodeString::fromUTF8( out.str() );
     if (tokDebug >= 5){
       DBG << "outputTokens: result= '" << result << "'" << endl;
     }
     return result;
   }
 
+  void TokenizerClass::restart_scan(){
+    /// let the next countSentences() start from the first token
+    scan_states.clear();
+    scan_state.quotelevel = 0;
+    scan_state.begin = 0;
+    scan_state.lang = no_language;
+    scan_state.count = 0;
+    scan_base = 0;
+    scan_base_count = 0;
+    scan_dirty = string::npos;
+    scan_pending = string::npos;
+  }
+
+  void TokenizerClass::scan_changed( size_t index ){
+    /// tell countSentences() that the roles of a token may have changed
+    /*!
+      \param index the token. All tokens from index on are looked at again
+    */
+    if ( index < scan_dirty ){
+      scan_dirty = index;
+    }
+  }
+
+  void TokenizerClass::scan_popped( size_t n ){
+    /// tell countSentences() that the first tokens are taken away
+    /*!
+      \param n the number of tokens removed from the front of the buffer
+
+      A new scan would start afresh at the new first token. When the state
+      we have there is equivalent (no open quote, a new sentence starts) we
+      just move our base. Otherwise the next scan starts from the front.
+    */
+    if ( n > scan_states.size() ){
+      restart_scan();
+      return;
+    }
+    const ScanState& at = ( n < scan_states.size() ) ? scan_states[n] : scan_state;
+    if ( at.quotelevel != 0
+	 || at.begin != scan_base + n ){
+      restart_scan();
+      return;
+    }
+    scan_base_count = at.count;
+    scan_base += n;
+    scan_states.erase( scan_states.begin(), scan_states.begin()+n );
+    // changes to the tokens that are gone don't matter anymore
+    scan_dirty = ( scan_dirty != string::npos && scan_dirty >= n )
+      ? scan_dirty - n : string::npos;
+    if ( scan_pending != string::npos ){
+      // when the first one is gone, we don't know where the next is
+      scan_pending = ( scan_pending >= n ) ? scan_pending - n : 0;
+    }
+  }
+
   int TokenizerClass::countSentences( bool forceentirebuffer ) {
     //Return the number of *completed* sentences in the token buffer
 
@@ -2126,20 +2874,42 @@ namespace Tokenizer {
     //BEGINOFSENTENCE and ENDOFSENTENCE always pair up, and that TEMPENDOFSENTENCE roles
     //are converted to proper ENDOFSENTENCE markers
 
-    short quotelevel = 0;
-    int count = 0;
-    const int size = tokens.size();
-    int begin = 0;
-    string cur_lang;
-    int tok_cnt = 0;
-    for ( auto& token : tokens ) {
-      if ( cur_lang.empty() ){
-	cur_lang = token.lang_code;
-      }
-      else if ( token.lang_code != cur_lang ){
-	tokens[tok_cnt-1].role |= ENDOFSENTENCE;
-	cur_lang = token.lang_code;
-      }
+    // We only scan from the first token that is new or has changed since
+    // the previous call. The state before it is the same as it would be
+    // after scanning all tokens in front of it again.
+    const size_t size = tokens.size();
+    size_t from = min( scan_dirty, scan_states.size() );
+    if ( forceentirebuffer ){
+      // the last token needs another look, it may have to end a sentence
+      from = min( from, scan_pending );
+      if ( size > 0 ){
+	from = min( from, size-1 );
+      }
+    }
+    if ( from < scan_states.size() ){
+      scan_state = scan_states[from];
+      scan_states.resize( from );
+    }
+    if ( scan_pending >= from ){
+      scan_pending = string::npos;
+    }
+    scan_dirty = string::npos;
+    for ( size_t tok_cnt = from; tok_cnt < size; ++tok_cnt ){
+      scan_states.push_back( scan_state );
+      Token& token = tokens[tok_cnt];
+      if ( scan_state.lang == no_language ){
+	scan_state.lang = token.lang_symbol();
+      }
+      else if ( token.lang_symbol() != scan_state.lang ){
+	if ( tok_cnt > 0
+	     && !( tokens[tok_cnt-1].role & ENDOFSENTENCE ) ){
+	  tokens[tok_cnt-1].role |= ENDOFSENTENCE;
+	  // this sentence is only counted by the next call
+	  scan_changed( tok_cnt-1 );
+	}
+	scan_state.lang = token.lang_symbol();
+      }
+      short& quotelevel = scan_state.quotelevel;
       if (tokDebug >= 5){
 	DBG << "[countSentences] buffer#" << tok_cnt
 	    << " token=[ " << token << " ], quotelevel="<< quotelevel << endl;
@@ -2147,35 +2917,42 @@ namespace Tokenizer {
       if (token.role & NEWPARAGRAPH) quotelevel = 0;
       if (token.role & BEGINQUOTE) quotelevel++;
       if (token.role & ENDQUOTE) quotelevel--;
-      if ( forceentirebuffer
-	   && (token.role & TEMPENDOFSENTENCE)
+      if ( (token.role & TEMPENDOFSENTENCE)
 	   && (quotelevel == 0)) {
-	//we thought we were in a quote, but we're not... No end quote was found and an end is forced now.
-	//Change TEMPENDOFSENTENCE to ENDOFSENTENCE and make sure sentences match up sanely
-	token.role &= ~TEMPENDOFSENTENCE;
-	token.role |= ENDOFSENTENCE;
+	if ( forceentirebuffer ){
+	  //we thought we were in a quote, but we're not... No end quote was found and an end is forced now.
+	  //Change TEMPENDOFSENTENCE to ENDOFSENTENCE and make sure sentences match up sanely
+	  token.role &= ~TEMPENDOFSENTENCE;
+	  token.role |= ENDOFSENTENCE;
+	}
+	else if ( tok_cnt < scan_pending ){
+	  scan_pending = tok_cnt;
+	}
       }
-      tokens[begin].role |= BEGINOFSENTENCE;  //sanity check
+      tokens[scan_state.begin - scan_base].role |= BEGINOFSENTENCE;  //sanity check
       if ( (token.role & ENDOFSENTENCE)
 	   && (quotelevel == 0) ) {
-	begin = tok_cnt + 1;
-	count++;
+	scan_state.begin = scan_base + tok_cnt + 1;
+	scan_state.count++;
 	if (tokDebug >= 5){
-	  DBG << "[countSentences] SENTENCE #" << count << " found" << endl;
+	  DBG << "[countSentences] SENTENCE #"
+	      << scan_state.count - scan_base_count << " found" << endl;
 	}
       }
       if ( forceentirebuffer
 	   && ( tok_cnt == size - 1)
 	   && !(token.role & ENDOFSENTENCE) )  {
 	//last token of buffer
-	count++;
+	scan_state.count++;
 	token.role |= ENDOFSENTENCE;
 	if (tokDebug >= 5){
-	  DBG << "[countSentences] SENTENCE #" << count << " *FORCIBLY* ended" << endl;
+	  DBG << "[countSentences] SENTENCE #"
+	      << scan_state.count - scan_base_count
+	      << " *FORCIBLY* ended" << endl;
 	}
       }
-      ++tok_cnt;
     }
+    const int count = scan_state.count - scan_base_count;
     if (tokDebug >= 5){
       DBG << "[countSentences] end of loop: returns " << count << endl;
     }
@@ -2210,15 +2987,16 @@ namespace Tokenizer {
 	    DBG << "[tokenize] extracted sentence, begin=" << begin
 		<< ",end="<< end << endl;
 	  }
-	  for ( size_t index=begin; index <= end; ++index ){
-	    outToks.push_back( tokens[index] );
-	  }
+	  outToks.assign( make_move_iterator( tokens.begin()+begin ),
+			  make_move_iterator( tokens.begin()+end+1 ) );
 	  tokens.erase( tokens.begin(), tokens.begin()+end+1 );
+	  scan_popped( end+1 );
 	  if ( !passthru ){
 	    string lang = get_language( outToks );
 	    if ( lang != "und" ){
-	      if ( !settings[lang]->quotes.emptyStack() ) {
-		settings[lang]->quotes.flushStack( end+1 );
+	      QuoteStack& stack = quote_stack( lang );
+	      if ( !stack.empty() ) {
+		stack.flush( end+1 );
 	      }
 	    }
 	  }
@@ -2283,54 +3061,27 @@ namespace Tokenizer {
 
   // FBK: return true if character is a quote.
   bool TokenizerClass::u_isquote( UChar32 c, const Quoting& quotes ) const {
-    bool quote = false;
-    if ( u_hasBinaryProperty( c, UCHAR_QUOTATION_MARK )
-	 || c == '`'
-	 || c == U'´' ) {
-      // M$ users use the spacing grave and acute accents often as a
-      // quote (apostroph) but is DOESN`T have the UCHAR_QUOTATION_MARK property
-      // so trick that
-      quote = true;
-    }
-    else {
-      UnicodeString opening = quotes.lookupOpen( c );
-      if (!opening.isEmpty()) {
-	quote = true;
-      }
-      else {
-	UnicodeString closing = quotes.lookupClose( c );
-	if (!closing.isEmpty()) {
-	  quote = true;
-	}
-      }
-    }
-    return quote;
+    // the Quotation_Mark property (plus ` and ´, which M$ users often use
+    // as a quote) and the configured quote pairs are all in the table of
+    // quotes
+    return quotes.isQuote( c );
   }
 
   //FBK: USED TO CHECK IF CHARACTER AFTER QUOTE IS AN BOS.
   //MOSTLY THE SAME AS ABOVE, EXCEPT WITHOUT CHECK FOR PUNCTUATION
   //BECAUSE: '"Hoera!", zei de man' MUST NOT BE SPLIT ON ','..
   bool is_BOS( UChar32 c ){
-    bool is_bos = false;
-    UBlockCode s = ublock_getCode(c);
-    //test for languages that distinguish case
-    if ( (s == UBLOCK_BASIC_LATIN) || (s == UBLOCK_GREEK)
-	 || (s == UBLOCK_CYRILLIC) || (s == UBLOCK_GEORGIAN)
-	 || (s == UBLOCK_ARMENIAN) || (s == UBLOCK_DESERET)) {
-      if ( u_isupper(c) || u_istitle(c) ) {
-	//next 'word' starts with more punctuation or with uppercase
-	is_bos = true;
-      }
-    }
-    return is_bos;
+    // uppercase, in a script that distinguishes case
+    return CharTable::unicode().is( c, CharTable::BOS );
   }
 
   bool TokenizerClass::resolveQuote( int endindex,
 				     const UnicodeString& open,
-				     Quoting& quotes ) {
+				     const Quoting& quotes,
+				     QuoteStack& stack ) {
     //resolve a quote
     int stackindex = -1;
-    int beginindex = quotes.lookup( open, stackindex );
+    int beginindex = stack.lookup( open, stackindex );
 
     if (beginindex >= 0) {
       if (tokDebug >= 2) {
@@ -2342,6 +3093,7 @@ namespace Tokenizer {
       }
 
       //We have a quote!
+      scan_changed( beginindex );
 
       //resolve sentences within quote, all sentences must be full sentences:
       int beginsentence = beginindex + 1;
@@ -2401,7 +3153,7 @@ namespace Tokenizer {
 	//something is wrong. Sentences within quote are not balanced, so we won't mark the quote.
       }
       //remove from stack (ok, granted, stack is a bit of a misnomer here)
-      quotes.eraseAtPos( stackindex );
+      stack.eraseAtPos( stackindex );
       //FBK: ENDQUOTES NEED TO BE MARKED AS ENDOFSENTENCE IF THE PREVIOUS TOKEN
       //WAS AN ENDOFSENTENCE. OTHERWISE THE SENTENCES WILL NOT BE SPLIT.
       if ( tokens[endindex].role & ENDQUOTE
@@ -2449,7 +3201,7 @@ namespace Tokenizer {
 	  }
 	  else if ( i + 2 < tokens.size() ) {
 	    c = tokens[i+2].us.char32At(0);
-	    if ( u_isupper(c) || u_istitle(c) || u_ispunct(c) ){
+	    if ( char_table->is( c, CharTable::UPPER | CharTable::PUNCT ) ){
 	      //next 'word' after quote starts with uppercase or is punct
 	      is_eos = true;
 	    }
@@ -2457,7 +3209,7 @@ namespace Tokenizer {
 	}
 	else if ( tokens[i].us.length() > 1 ){
 	  // PUNCTUATION multi...
-	  if ( u_isupper(c) || u_istitle(c) )
+	  if ( char_table->is( c, CharTable::UPPER ) )
 	    is_eos = true;
 	}
 	else
@@ -2468,29 +3220,30 @@ namespace Tokenizer {
   }
 
   void TokenizerClass::detectQuoteBounds( const int i,
-					  Quoting& quotes ) {
+					  const Quoting& quotes,
+					  QuoteStack& stack ) {
     UChar32 c = tokens[i].us.char32At(0);
     //Detect Quotation marks
     if ((c == '"') || ( UnicodeString(c) == "＂") ) {
       if (tokDebug > 1 ){
 	DBG << "[detectQuoteBounds] Standard double-quote (ambiguous) found @i="<< i << endl;
       }
-      if (!resolveQuote(i,c,quotes)) {
+      if (!resolveQuote( i, c, quotes, stack )) {
 	if (tokDebug > 1 ) {
 	  DBG << "[detectQuoteBounds] Doesn't resolve, so assuming beginquote, pushing to stack for resolution later" << endl;
 	}
-	quotes.push( i, c );
+	stack.push( i, c );
       }
     }
     else if ( c == '\'' ) {
       if (tokDebug > 1 ){
 	DBG << "[detectQuoteBounds] Standard single-quote (ambiguous) found @i="<< i << endl;
       }
-      if (!resolveQuote(i,c,quotes)) {
+      if (!resolveQuote( i, c, quotes, stack )) {
 	if (tokDebug > 1 ) {
 	  DBG << "[detectQuoteBounds] Doesn't resolve, so assuming beginquote, pushing to stack for resolution later" << endl;
 	}
-	quotes.push( i, c );
+	stack.push( i, c );
       }
     }
     else {
@@ -2499,7 +3252,7 @@ namespace Tokenizer {
 	if ( tokDebug > 1 ) {
 	  DBG << "[detectQuoteBounds] Opening quote found @i="<< i << ", pushing to stack for resolution later..." << endl;
 	}
-	quotes.push( i, c ); // remember it
+	stack.push( i, c ); // remember it
       }
       else {
 	UnicodeString open = quotes.lookupClose( c );
@@ -2507,7 +3260,7 @@ namespace Tokenizer {
 	  if (tokDebug > 1 ) {
 	    DBG << "[detectQuoteBounds] Closing quote found @i="<< i << ", attempting to resolve..." << endl;
 	  }
-	  if ( !resolveQuote( i, open, quotes )) {
+	  if ( !resolveQuote( i, open, quotes, stack )) {
 	    // resolve the matching opening
 	    if (tokDebug > 1 ) {
 	      DBG << "[detectQuoteBounds] Unable to resolve" << endl;
@@ -2536,24 +3289,25 @@ namespace Tokenizer {
     else {
       method = "[detectSentenceBounds]";
     }
+    const Setting *set = get_setting( lang );
     const int size = tokens.size();
     for (int i = offset; i < size; i++) {
       if (tokDebug > 1 ){
 	DBG << method << " i="<< i << " token=[ " << tokens[i] << " ]" << endl;
       }
-      if ( tokens[i].type.startsWith("PUNCTUATION") ){
+      if ( tokens[i].type().startsWith(type_punctuation) ){
 	if ((tokDebug > 1 )){
 	  DBG << method << " PUNCTUATION FOUND @i=" << i << endl;
 	}
 	// we have some kind of punctuation. Does it mark an eos?
 	bool is_eos = detectEos( i,
-				 settings[lang]->eosmarkers,
-				 settings[lang]->quotes );
+				 set->eosmarkers,
+				 set->quotes );
 	is_eos &= !sentenceperlineinput;
 	if ( is_eos) {
 	  // end of sentence found/ so wrap up
 	  if ( detectQuotes
-	       && !settings[lang]->quotes.emptyStack() ) {
+	       && !quote_stack( lang ).empty() ) {
 	    // we have some quotes!
 	    if ( tokDebug > 1 ){
 	      DBG << method << " Unbalances quotes: Preliminary EOS FOUND @i="
@@ -2604,7 +3358,7 @@ namespace Tokenizer {
 	}
 	if ( detectQuotes ){
 	  // check the quotes
-	  detectQuoteBounds( i, settings[lang]->quotes );
+	  detectQuoteBounds( i, set->quotes, quote_stack( lang ) );
 	}
       }
     }
@@ -2617,7 +3371,7 @@ namespace Tokenizer {
 	DBG << method << " fixup-end i="<< i << " token=[ " << tokens[i]
 	    << " ]" << endl;
       }
-      if ( tokens[i].type.startsWith("PUNCTUATION") ) {
+      if ( tokens[i].type().startsWith(type_punctuation) ) {
 	tokens[i].role &= ~BEGINOFSENTENCE;
 	if ( !detectQuotes ||
 	     (tokens[i].role & BEGINQUOTE) ){
@@ -2639,19 +3393,20 @@ namespace Tokenizer {
   }
 
   bool TokenizerClass::is_separator( UChar32 c ){
-    bool result = false;
-    if ( space_separated ){
-      result = u_isspace( c );
-    }
-    result |= ( separators.find( c ) != separators.end() );
-    return result;
+    // the table is kept up to date by setSeparators()
+    return char_table->is( c, CharTable::SEPARATOR );
   }
 
   void TokenizerClass::passthruLine( const UnicodeString& input, bool& bos ) {
     if (tokDebug) {
       DBG << "[passthruLine] input: line=[" << input << "]" << endl;
     }
+    const size_t first = tokens.size();
     bool alpha = false, num = false, punct = false;
+    // when no ASCII letter is a separator, runs of them are appended at once
+    const bool fast_letters = char_table->plain_letters( CharTable::SEPARATOR );
+    const UChar *buffer = input.getBuffer();
+    const int32_t ulen = input.length();
     UnicodeString word;
     StringCharacterIterator sit(input);
     while ( sit.hasNext() ){
@@ -2722,16 +3477,29 @@ namespace Tokenizer {
 	}
       }
       else {
-	if ( u_isalpha(c)) {
+	const CharTable::Flags flags = char_table->flags( c );
+	if ( flags & CharTable::ALPHA ) {
 	  alpha = true;
 	}
-	else if (u_ispunct(c)) {
+	else if ( flags & CharTable::PUNCT ) {
 	  punct = true;
 	}
-	else if (u_isdigit(c)) {
+	else if ( flags & CharTable::DIGIT ) {
 	  num = true;
 	}
 	word += c;
+	if ( fast_letters ){
+	  sit.next32();
+	  const int32_t pos = sit.getIndex();
+	  const int32_t run = CharTable::ascii_letters( buffer + pos,
+							ulen - pos );
+	  if ( run > 0 ){
+	    alpha = true;
+	    word.append( input, pos, run );
+	    sit.setIndex( pos + run );
+	  }
+	  continue;
+	}
       }
       sit.next32();
     }
@@ -2780,7 +3548,11 @@ namespace Tokenizer {
 	}
       }
     }
+    if ( keep_quoted_spaces ){
+      unmark_quoted_spaces( first );
+    }
     if ( sentenceperlineinput && tokens.size() > 0 ) {
+      scan_changed( 0 );
       tokens[0].role |= BEGINOFSENTENCE;
       tokens.back().role |= ENDOFSENTENCE;
     }
@@ -2792,32 +3564,39 @@ namespace Tokenizer {
     }
   }
 
-  string TokenizerClass::checkBOM( istream& in ){
-    string result = inputEncoding;
-    if ( &in == &cin ){
-      return result;
+  void TokenizerClass::open_input( istream& in ){
+    /// start reading a new input stream
+    /*!
+      \param in the stream. Unless it starts with a byte order mark, it is
+      decoded using the inputEncoding
+    */
+    input_decoder.reset( new InputDecoder( in, inputEncoding ) );
+    if ( tokDebug
+	 && input_decoder->encoding() != inputEncoding ){
+      DBG << "Autodetected encoding: " << input_decoder->encoding() << endl;
+    }
+  }
+
+  void TokenizerClass::report_invalid( const vector<uint64_t>& bad ){
+    /// tell where the current line has invalid UTF-8
+    /*!
+      \param bad the byte offsets (in the input) of the ill-formed sequences
+    */
+    string offsets;
+    for ( const auto& b : bad ){
+      if ( !offsets.empty() ){
+	offsets += ",";
+      }
+      offsets += to_string( b );
+    }
+    if ( replace_invalid ){
+      LOG << "WARNING: Invalid UTF-8 in line:" << linenum
+	  << " at byte offset: " << offsets << ". Replaced by U+FFFD" << endl;
+    }
+    else {
+      LOG << "ERROR: Invalid UTF-8 in line:" << linenum
+	  << " at byte offset: " << offsets << ". Skipped ..." << endl;
     }
-    streampos pos = in.tellg();
-    string s;
-    in >> s;
-    UErrorCode err = U_ZERO_ERROR;
-    int32_t bomLength = 0;
-    const char *encoding = ucnv_detectUnicodeSignature( s.c_str(),
-							s.length(),
-							&bomLength,
-							&err);
-    if ( bomLength ){
-      if ( tokDebug ){
-	DBG << "Autodetected encoding: " << encoding << endl;
-      }
-      result = encoding;
-      if ( result == "UTF16BE"
-	   || result == "UTF-16BE" ){
-	result = "UTF16BE";
-      }
-    }
-    in.seekg( pos + (streampos)bomLength );
-    return result;
   }
 
   // string wrapper
@@ -2838,73 +3617,36 @@ namespace Tokenizer {
     countSentences(true); // force the ENDOFSENTENCE
   }
 
-  bool u_isemo( UChar32 c ){
-    UBlockCode s = ublock_getCode(c);
-    return s == UBLOCK_EMOTICONS;
-  }
-
-  bool u_isothernumber( UChar32 c ){
-    return u_charType( c ) == U_OTHER_NUMBER;
-  }
-
-  bool u_isnonspacemark( UChar32 c ){
-    return u_charType( c ) == U_NON_SPACING_MARK;
-  }
-
-  bool u_ispicto( UChar32 c ){
-    UBlockCode s = ublock_getCode(c);
-    return s == UBLOCK_MISCELLANEOUS_SYMBOLS_AND_PICTOGRAPHS ;
-  }
-
-  bool u_iscurrency( UChar32 c ){
-    return u_charType( c ) == U_CURRENCY_SYMBOL;
-  }
-
-  bool u_isBOM( UChar32 c ){
-    return c == 0xfeff
-      || c == 0xfffe
-      || c == 0xefbbbf;
-  }
-
-  bool u_issymbol( UChar32 c ){
-    return u_charType( c ) == U_CURRENCY_SYMBOL
-      || u_charType( c ) == U_MATH_SYMBOL
-      || u_charType( c ) == U_MODIFIER_SYMBOL
-      || u_charType( c ) == U_OTHER_SYMBOL;
-  }
-
   const UnicodeString& TokenizerClass::detect_type( UChar32 c ){
-    if ( is_separator(c)) {
+    const CharTable::Flags flags = char_table->flags( c );
+    if ( flags & CharTable::SEPARATOR ) {
       return type_separator;
     }
-    else if ( u_iscurrency(c)) {
+    else if ( flags & CharTable::CURRENCY ) {
       return type_currency;
     }
-    else if ( u_ispunct(c)) {
+    else if ( flags & CharTable::PUNCT ) {
       return type_punctuation;
     }
-    else if ( u_isemo( c ) ) {
+    else if ( flags & CharTable::EMOTICON ) {
       return type_emoticon;
     }
-    else if ( u_ispicto( c ) ) {
+    else if ( flags & CharTable::PICTO ) {
       return type_picto;
     }
-    else if ( u_isalpha(c)) {
+    else if ( flags & CharTable::ALPHA ) {
       return type_word;
     }
-    else if ( u_isdigit(c)) {
+    else if ( flags & ( CharTable::DIGIT | CharTable::OTHER_NUMBER ) ) {
       return type_number;
     }
-    else if ( u_isothernumber(c)) {
-      return type_number;
-    }
-    else if ( u_issymbol(c)) {
+    else if ( flags & CharTable::SYMBOL ) {
       return type_symbol;
     }
-    else if ( u_isBOM(c)) {
+    else if ( flags & CharTable::BOM ) {
       return type_BOM;
     }
-    else if ( u_isnonspacemark(c)) {
+    else if ( flags & CharTable::NONSPACING_MARK ) {
       return type_symbol;
     }
     else {
@@ -2980,30 +3722,143 @@ namespace Tokenizer {
     }
   }
 
-  UnicodeString replace_quoted_spaces( const UnicodeString& in ){
-    UnicodeString result;
+  const Normalizer2 *TokenizerClass::find_normalizer( const string& mode ){
+    /// get the ICU normalizer for a normalization mode
+    /*!
+      \param mode the mode, as the UnicodeNormalizer knows it
+      \return the normalizer, or 0 if we don't know mode
+    */
+    UErrorCode err = U_ZERO_ERROR;
+    const Normalizer2 *result = 0;
+    if ( mode == "NFC" ){
+      result = Normalizer2::getNFCInstance( err );
+    }
+    else if ( mode == "NFD" ){
+      result = Normalizer2::getNFDInstance( err );
+    }
+    else if ( mode == "NFKC" ){
+      result = Normalizer2::getNFKCInstance( err );
+    }
+    else if ( mode == "NFKD" ){
+      result = Normalizer2::getNFKDInstance( err );
+    }
+    return U_SUCCESS( err ) ? result : 0;
+  }
+
+  const UnicodeString& TokenizerClass::normalize_line( const UnicodeString& line ){
+    /// normalize a line of input
+    /*!
+      \param line the line
+      \return line itself when it is normalized already (which is usually
+      the case), otherwise the normalized copy, in normalized_line
+
+      Only the part after the longest prefix that is surely normalized,
+      is normalized again.
+    */
+    if ( quick_normalizer ){
+      UErrorCode err = U_ZERO_ERROR;
+      const int32_t span = quick_normalizer->spanQuickCheckYes( line, err );
+      if ( U_SUCCESS( err ) ){
+	if ( span == line.length() ){
+	  return line;
+	}
+	normalized_line.setTo( line, 0, span );
+	quick_normalizer->normalizeSecondAndAppend( normalized_line,
+						    line.tempSubString( span ),
+						    err );
+	if ( U_SUCCESS( err ) ){
+	  return normalized_line;
+	}
+      }
+    }
+    normalized_line = normalizer.normalize( line );
+    return normalized_line;
+  }
+
+  const UnicodeString& TokenizerClass::prepare_line( const UnicodeString& line,
+						     const Setting *set ){
+    /// mark the spaces inside quotes, and apply the FILTER of set
+    /*!
+      \param line the line
+      \param set the Setting to use
+      \return line itself when nothing changes, otherwise the changed
+      copy, in prepared_line
+
+      A space between a pair of " or ' quotes is marked as Ž, when
+      keep_quoted_spaces is set. unmark_quoted_spaces() turns it into a
+      space again, in the Tokens.
+      Both are done in one pass, and only the characters that change
+      are looked at twice.
+    */
+    const FilterTable *table = 0;
+    if ( doFilter && !set->filter_table.empty() ){
+      table = &set->filter_table;
+    }
+    if ( !table && !keep_quoted_spaces ){
+      return line;
+    }
+    const UChar *s = line.getBuffer();
+    const int32_t len = line.length();
+    bool changed = false;
+    int32_t copied = 0; // the part of line that is in prepared_line
     UChar32 quote = '\x0';
-    for ( int i=0; i < in.length(); ++i ){
-      UChar32 c = in[i];
-      //      cerr << "bekijk: " << UnicodeString( c ) << endl;
-      if ( c == '"' || c == '\'' ){
-	// found quote
-	//	cerr << "found quote!" << endl;
-	if ( c == quote ){
-	  // so a second one, reset
-	  quote = '\x0';
-	  //	  cerr << "reset quote!" << endl;
+    int32_t i = 0;
+    while ( i < len ){
+      const UChar u = s[i];
+      const bool quoting = keep_quoted_spaces
+	&& ( u == ' ' || u == '"' || u == '\'' );
+      if ( !quoting
+	   && !( table && table->marked( u ) ) ){
+	++i;
+	continue;
+      }
+      const int32_t start = i;
+      UChar32 c;
+      U16_NEXT( s, i, len, c );
+      UChar32 mark = c;
+      if ( quoting ){
+	if ( c != ' ' ){
+	  // found quote. A second one resets
+	  quote = ( c == quote ) ? '\x0' : c;
 	}
-	else {
-	  quote = c;
+	else if ( quote != '\x0' ){
+	  mark = U'Ž';
 	}
       }
-      else if ( c == ' ' && quote != '\x0' ){
-	c = U'Ž'; // mark as  Ž
+      const UnicodeString *replacement = table ? table->find( mark ) : 0;
+      if ( !replacement && mark == c ){
+	continue;
+      }
+      if ( !changed ){
+	prepared_line.remove();
+	changed = true;
+      }
+      prepared_line.append( s + copied, start - copied );
+      if ( replacement ){
+	prepared_line.append( *replacement );
+      }
+      else {
+	prepared_line.append( mark );
+      }
+      copied = i;
+    }
+    if ( !changed ){
+      return line;
+    }
+    prepared_line.append( s + copied, len - copied );
+    return prepared_line;
+  }
+
+  void TokenizerClass::unmark_quoted_spaces( size_t from ){
+    /// turn the marks prepare_line() made into spaces again
+    /*!
+      \param from the first of the tokens to look at
+    */
+    for ( size_t i=from; i < tokens.size(); ++i ){
+      if ( tokens[i].us.indexOf( (UChar)U'Ž' ) >= 0 ){
+	tokens[i].us = filter_ZCARON( tokens[i].us );
       }
-      result += c;
     }
-    return result;
   }
 
   int TokenizerClass::internal_tokenize_line( const UnicodeString& originput,
@@ -3018,8 +3873,10 @@ namespace Tokenizer {
       lang = "default";
     }
     else {
+      // a language that can't be read is just as unknown
       auto const it = settings.find( lang );
-      if ( it == settings.end() ){
+      if ( it == settings.end()
+	   || ( it->second && !get_setting( lang ) ) ){
 	LOG << "[internal_tokenize_line]: no settings found for language="
 	    << lang << endl
 	    << "using the default language instead:" << default_language << endl;
@@ -3030,13 +3887,10 @@ namespace Tokenizer {
       DBG << "[internal_tokenize_line] input: line=["
 	  << originput << "] (language= " << lang << ")" << endl;
     }
-    UnicodeString input = originput;
-    if ( keep_quoted_spaces ){
-      input = replace_quoted_spaces( input );
-    }
-    if ( doFilter ){
-      input = settings[lang]->filter.filter( input );
-    }
+    // look the language up only once for the whole line
+    const Setting *set = get_setting( lang );
+    const Symbol lang_sym = Token::intern_language( lang );
+    const UnicodeString& input = prepare_line( originput, set );
     int32_t len = input.countChar32();
     if (tokDebug){
       DBG << "[internal_tokenize_line] filtered input: line=["
@@ -3052,12 +3906,24 @@ namespace Tokenizer {
     bool tokenizeword = false;
     bool reset_token = false;
     //iterate over all characters
+    const Quoting& quotes = set->quotes;
+    // a plain ASCII letter (no separator, punctuation or quote) needs
+    // nothing but appending to the current word. So when inside a word,
+    // a run of those is appended at once.
+    const bool fast_letters = tokDebug <= 8
+      && char_table->plain_letters( CharTable::SEPARATOR | CharTable::PUNCT
+				   | CharTable::DIGIT | CharTable::EMOTICON )
+      && quotes.plainLetters();
+    const UChar *buffer = input.getBuffer();
+    const int32_t ulen = input.length();
     UnicodeString word;
     StringCharacterIterator sit(input);
     long int i = 0;
     long int tok_size = 0;
     while ( sit.hasNext() ){
       UChar32 c = sit.current32();
+      const CharTable::Flags flags = char_table->flags( c );
+      const bool separator = flags & CharTable::SEPARATOR;
       bool joiner = false;
       if ( c == ZWJ ){
 	joiner = true;
@@ -3072,7 +3938,7 @@ namespace Tokenizer {
       if ( reset_token ) { //reset values for new word
 	reset_token = false;
 	tok_size = 0;
-	if ( !joiner && !is_separator(c) ){
+	if ( !joiner && !separator ){
 	  word = c;
 	}
 	else {
@@ -3080,7 +3946,7 @@ namespace Tokenizer {
 	}
 	tokenizeword = false;
       }
-      else if ( !joiner && !is_separator(c) ){
+      else if ( !joiner && !separator ){
 	word += c;
       }
       if ( joiner && sit.hasNext() ){
@@ -3090,17 +3956,16 @@ namespace Tokenizer {
 	}
 	sit.previous32();
       }
-      if ( is_separator(c) || joiner || i == len-1 ){
+      if ( separator || joiner || i == len-1 ){
 	if (tokDebug){
 	  DBG << "[internal_tokenize_line] space detected, word=["
 	      << word << "]" << endl;
 	}
 	if ( i == len-1 ) {
 	  if ( joiner
-	       || u_ispunct(c)
-	       || u_isdigit(c)
-	       || u_isquote( c, settings[lang]->quotes )
-	       || u_isemo(c) ){
+	       || ( flags & ( CharTable::PUNCT | CharTable::DIGIT
+			      | CharTable::EMOTICON ) )
+	       || u_isquote( c, quotes ) ){
 	    tokenizeword = true;
 	  }
 	}
@@ -3122,25 +3987,23 @@ namespace Tokenizer {
 	    }
 	    int eospos = tokens.size()-1;
 	    if (expliciteosfound > 0) {
-	      UnicodeString realword;
-	      word.extract(0,expliciteosfound,realword);
+	      const UnicodeString realword
+		= word.tempSubString( 0, expliciteosfound );
 	      if (tokDebug >= 2) {
 		DBG << "[internal_tokenize_line] Prefix before EOS: "
 		    << realword << endl;
 	      }
-	      tokenizeWord( realword, false, lang );
+	      tokenizeWord( realword, false, set, lang_sym );
 	      eospos++;
 	    }
 	    if ( expliciteosfound + utt_mark.length() < word.length() ){
-	      UnicodeString realword;
-	      word.extract( expliciteosfound+utt_mark.length(),
-			    word.length() - expliciteosfound - utt_mark.length(),
-			    realword );
+	      const UnicodeString realword
+		= word.tempSubString( expliciteosfound+utt_mark.length() );
 	      if (tokDebug >= 2){
 		DBG << "[internal_tokenize_line] postfix after EOS: "
 		    << realword << endl;
 	      }
-	      tokenizeWord( realword, true, lang );
+	      tokenizeWord( realword, true, set, lang_sym );
 	    }
 	    if ( !tokens.empty() && eospos >= 0 ) {
 	      if (tokDebug >= 2){
@@ -3157,19 +4020,18 @@ namespace Tokenizer {
 			    << word << "]" << endl;
 	  }
 	  if ( tokenizeword ) {
-	    tokenizeWord( word, !joiner, lang );
+	    tokenizeWordCached( word, !joiner, set, lang_sym );
 	  }
 	  else {
-	    tokenizeWord( word, !joiner, lang, type_word );
+	    tokenizeWordCached( word, !joiner, set, lang_sym, type_word );
 	  }
 	}
 	//reset values for new word
 	reset_token = true;
       }
-      else if ( u_ispunct(c)
-		|| u_isdigit(c)
-		|| u_isquote( c, settings[lang]->quotes )
-		|| u_isemo(c) ){
+      else if ( ( flags & ( CharTable::PUNCT | CharTable::DIGIT
+			    | CharTable::EMOTICON ) )
+		|| u_isquote( c, quotes ) ){
 	if (tokDebug){
 	  DBG << "[internal_tokenize_line] punctuation or digit detected, word=["
 	      << word << "]" << endl;
@@ -3187,6 +4049,25 @@ namespace Tokenizer {
 	    << "..." << endl;
 	return 0;
       }
+      if ( fast_letters && !reset_token ){
+	const int32_t pos = sit.getIndex();
+	// never take the last character, nor go beyond the maximum word size
+	const int32_t max = std::min( len - 1 - i, 2500 - tok_size );
+	if ( max > 0 ){
+	  const int32_t run
+	    = CharTable::ascii_letters( buffer + pos,
+					std::min( max, ulen - pos ) );
+	  if ( run > 0 ){
+	    word.append( input, pos, run );
+	    sit.setIndex( pos + run );
+	    i += run;
+	    tok_size += run;
+	  }
+	}
+      }
+    }
+    if ( keep_quoted_spaces ){
+      unmark_quoted_spaces( begintokencount );
     }
     int numNewTokens = tokens.size() - begintokencount;
     if (tokDebug >= 10){
@@ -3210,9 +4091,94 @@ namespace Tokenizer {
     return numNewTokens;
   }
 
+  void TokenizerClass::tokenizeWordCached( const UnicodeString& word,
+					   bool space,
+					   const Setting *set,
+					   Symbol lang,
+					   const UnicodeString& assigned_type ) {
+    /// tokenize a whitespace delimited word, using the word cache
+    /*!
+      \param word the word to tokenize
+      \param space is the word followed by a space?
+      \param set the Setting of the language of the word
+      \param lang the language of the word, as a Symbol
+      \param assigned_type the type to assign when no rule matches. When
+      empty, the word is run through all rules
+
+      When the word was seen before, the Tokens are taken from the cache.
+      Otherwise the word is handled by tokenizeWord() and the result is
+      remembered. The cache isn't used when debugging or profiling the
+      rules, as all words must go through them then.
+    */
+    if ( tokDebug > 0
+	 || profile_rules
+	 || word_cache.capacity() == 0 ){
+      // when debugging, we want to see all steps taken
+      tokenizeWord( word, space, set, lang, assigned_type );
+      return;
+    }
+    const int flags = ( space ? 1 : 0 )
+      | ( assigned_type.isEmpty() ? 0 : 2 )
+      | ( doPunctFilter ? 4 : 0 )
+      | ( keep_quoted_spaces ? 8 : 0 );
+    const size_t first = tokens.size();
+    const WordCache::Entry *hit = word_cache.find( lang, word, flags );
+    if ( hit ){
+      if ( hit->unspace_previous && first > 0 ){
+	tokens.back().role &= ~NOSPACE;
+      }
+      tokens.insert( tokens.end(), hit->tokens.begin(), hit->tokens.end() );
+      if ( paragraphsignal_next && tokens.size() > first ){
+	tokens[first].role |= NEWPARAGRAPH;
+	paragraphsignal_next = false;
+      }
+      return;
+    }
+    // tokenizeWord() might remove the NOSPACE from the last token we
+    // already have. Set it temporarily, to find out.
+    TokenRole previous_role = NOROLE;
+    if ( first > 0 ){
+      previous_role = tokens.back().role;
+      tokens.back().role |= NOSPACE;
+    }
+    const bool new_paragraph = paragraphsignal_next;
+    tokenizeWord( word, space, set, lang, assigned_type );
+    WordCache::Entry entry;
+    entry.unspace_previous = false;
+    if ( first > 0 ){
+      entry.unspace_previous = !( tokens[first-1].role & NOSPACE );
+      tokens[first-1].role = previous_role;
+      if ( entry.unspace_previous ){
+	tokens[first-1].role &= ~NOSPACE;
+      }
+    }
+    else if ( doPunctFilter ){
+      // we cannot tell
+      return;
+    }
+    for ( size_t i=first; i < tokens.size(); ++i ){
+      if ( tokens[i].type_symbol() == unknown_symbol ){
+	// keep warning about these
+	return;
+      }
+      entry.tokens.push_back( tokens[i] );
+    }
+    if ( new_paragraph && !entry.tokens.empty() ){
+      entry.tokens.front().role &= ~NEWPARAGRAPH;
+    }
+    for ( int32_t i=0; i < word.length(); ++i ){
+      if ( char_table->is( word[i], CharTable::BOM ) ){
+	// keep warning about these too
+	return;
+      }
+    }
+    word_cache.insert( lang, word, flags, entry );
+  }
+
   void TokenizerClass::tokenizeWord( const UnicodeString& input,
 				     bool space,
-				     const string& lang,
+				     const Setting *set,
+				     Symbol lang,
 				     const UnicodeString& assigned_type ) {
     bool recurse = !assigned_type.isEmpty();
 
@@ -3245,7 +4211,7 @@ namespace Tokenizer {
     }
     bool special=false;
     if ( inpLen == 2 ){
-      if ( u_isnonspacemark( input.char32At(1) ) ){
+      if ( char_table->is( input.char32At(1), CharTable::NONSPACING_MARK ) ){
 	// NO further processing!, belong together
 	if ( tokDebug >= 2 ){
 	  DBG << "single combining letter " << input << endl;
@@ -3310,29 +4276,72 @@ namespace Tokenizer {
     }
     else {
       bool a_rule_matched = false;
-      for ( const auto& rule : settings[lang]->rules ) {
+      vector<RuleProfile> *profile = 0;
+      chrono::steady_clock::time_point word_start;
+      if ( profile_rules ){
+	profile = &rule_profile[set];
+	profile->resize( set->rules.size() + 1 );
+	word_start = chrono::steady_clock::now();
+      }
+      // one scan over the input tells which rules are worth trying
+      const RuleSet::Signature sig = set->ruleset.scan( input );
+      vector<unique_ptr<RegexMatcher>>& matchers = rule_matchers[set];
+      if ( matchers.empty() ){
+	matchers.resize( set->rules.size() );
+      }
+      for ( size_t r=0; r < set->rules.size(); ++r ) {
+	if ( !set->ruleset.may_match( r, sig ) ){
+	  if ( profile ){
+	    ++(*profile)[r].skipped;
+	  }
+	  continue;
+	}
+	const Rule *rule = set->rules[r];
+	if ( !matchers[r] ){
+	  matchers[r].reset( rule->new_matcher() );
+	}
 	if ( tokDebug >= 4){
 	  DBG << "\tTESTING " << rule->id << endl;
 	}
 	UnicodeString type = rule->id;
 	//Find first matching rule
-	UnicodeString pre, post;
-	vector<UnicodeString> matches;
-	if ( rule->matchAll( input, pre, post, matches ) ){
+	// the results are Spans into input, substrings of input are only
+	// read-only aliases, the final Token makes the one real copy
+	Rule::Span pre, post;
+	vector<Rule::Span> matches;
+	chrono::steady_clock::time_point start;
+	if ( profile ){
+	  start = chrono::steady_clock::now();
+	}
+	const bool matched = matchers[r]
+	  && rule->matchAll( *matchers[r], input, pre, post, matches );
+	if ( profile ){
+	  RuleProfile& prof = (*profile)[r];
+	  ++prof.attempts;
+	  prof.nanoseconds += chrono::duration_cast<chrono::nanoseconds>
+	    ( chrono::steady_clock::now() - start ).count();
+	  if ( matched ){
+	    ++prof.matches;
+	  }
+	}
+	if ( matched ){
 	  a_rule_matched = true;
 	  if ( tokDebug >= 4 ){
 	    DBG << "\tMATCH: " << type << endl;
-	    DBG << "\tpre=  '" << pre << "'" << endl;
-	    DBG << "\tpost= '" << post << "'" << endl;
+	    DBG << "\tpre=  '" << input.tempSubString( pre.start, pre.length )
+		<< "'" << endl;
+	    DBG << "\tpost= '" << input.tempSubString( post.start, post.length )
+		<< "'" << endl;
 	    int cnt = 0;
 	    for ( const auto& m : matches ){
-	      DBG << "\tmatch[" << ++cnt << "]='" << m << "'" << endl;
+	      DBG << "\tmatch[" << ++cnt << "]='"
+		  << input.tempSubString( m.start, m.length ) << "'" << endl;
 	    }
 	  }
 	  if ( recurse
 	       && ( type == type_word
-		    || ( pre.isEmpty()
-			 && post.isEmpty() ) ) ){
+		    || ( pre.empty()
+			 && post.empty() ) ) ){
 	    // so only do this recurse step when:
 	    //   OR we have a WORD
 	    //   OR we have an exact match of the rule (no pre or post)
@@ -3364,12 +4373,14 @@ namespace Tokenizer {
 	      return;
 	    }
 	  }
-	  if ( pre.length() > 0 ){
+	  if ( !pre.empty() ){
+	    const UnicodeString pre_context
+	      = input.tempSubString( pre.start, pre.length );
 	    if ( tokDebug >= 4 ){
-	      DBG << "\tTOKEN pre-context (" << pre.length()
-			      << "): [" << pre << "]" << endl;
+	      DBG << "\tTOKEN pre-context (" << pre.length
+			      << "): [" << pre_context << "]" << endl;
 	    }
-	    tokenizeWord( pre, false, lang ); //pre-context, no space after
+	    tokenizeWord( pre_context, false, set, lang ); //pre-context, no space after
 	  }
 	  if ( matches.size() > 0 ){
 	    int max = matches.size();
@@ -3377,15 +4388,17 @@ namespace Tokenizer {
 	      DBG << "\tTOKEN match #=" << matches.size() << endl;
 	    }
 	    for ( int m=0; m < max; ++m ){
+	      UnicodeString word = input.tempSubString( matches[m].start,
+							matches[m].length );
 	      if ( tokDebug >= 4 ){
-		DBG << "\tTOKEN match[" << m << "] = " << matches[m]
+		DBG << "\tTOKEN match[" << m << "] = " << word
 		    << " Space=" << (space?"TRUE":"FALSE") << endl;
 	      }
 	      if ( doPunctFilter
 		   && (&rule->id)->startsWith("PUNCTUATION") ){
 		if (tokDebug >= 2 ){
 		  DBG << "   [tokenizeWord] skipped PUNCTUATION ["
-				  << matches[m] << "]" << endl;
+				  << word << "]" << endl;
 		}
 		if ( !tokens.empty() ){
 		  tokens.back().role &= ~NOSPACE;
@@ -3393,13 +4406,12 @@ namespace Tokenizer {
 	      }
 	      else {
 		bool internal_space = space;
-		if ( post.length() > 0 ) {
+		if ( !post.empty() ) {
 		  internal_space = false;
 		}
 		else if ( m < max-1 ){
 		  internal_space = false;
 		}
-		UnicodeString word = matches[m];
 		if ( norm_set.find( type ) != norm_set.end() ){
 		  word = "{{" + type + "}}";
 		  TokenRole role = (internal_space ? NOROLE : NOSPACE);
@@ -3419,7 +4431,7 @@ namespace Tokenizer {
 		    tokens.push_back( Token( type, word, role, lang ) );
 		  }
 		  else {
-		    tokenizeWord( word, internal_space, lang, type );
+		    tokenizeWord( word, internal_space, set, lang, type );
 		  }
 		}
 	      }
@@ -3429,12 +4441,14 @@ namespace Tokenizer {
 	    // should never come here?
 	    DBG << "\tPANIC there's no match" << endl;
 	  }
-	  if ( post.length() > 0 ){
+	  if ( !post.empty() ){
+	    const UnicodeString post_context
+	      = input.tempSubString( post.start, post.length );
 	    if ( tokDebug >= 4 ){
-	      DBG << "\tTOKEN post-context (" << post.length()
-			      << "): [" << post << "]" << endl;
+	      DBG << "\tTOKEN post-context (" << post.length
+			      << "): [" << post_context << "]" << endl;
 	    }
-	    tokenizeWord( post, space, lang );
+	    tokenizeWord( post_context, space, set, lang );
 	  }
 	  break;
 	}
@@ -3444,6 +4458,12 @@ namespace Tokenizer {
 	if ( tokDebug >=4 ){
 	  DBG << "\tthere's no match at all" << endl;
 	}
+	if ( profile ){
+	  RuleProfile& prof = profile->back();
+	  ++prof.attempts;
+	  prof.nanoseconds += chrono::duration_cast<chrono::nanoseconds>
+	    ( chrono::steady_clock::now() - word_start ).count();
+	}
 	TokenRole role = (space ? NOROLE : NOSPACE);
 	if ( paragraphsignal_next ){
 	  role |= NEWPARAGRAPH;
@@ -3463,21 +4483,25 @@ namespace Tokenizer {
       DBG << "Initiating tokenizer..." << endl;
     }
     data_version = get_data_version();
-    Setting *set = new Setting();
-    if ( !set->read( fname, tname, tokDebug, theErrLog, theDbgLog ) ){
+    word_cache.clear();
+    config_serial = ++last_config_serial;
+    rule_matchers.clear();
+    shared_ptr<const Setting> set = Setting::acquire( fname, tname, tokDebug,
+						      theErrLog, theDbgLog );
+    if ( !set ){
       LOG << "Cannot read Tokenizer settingsfile " << fname << endl;
       LOG << "Unsupported language? (Did you install the uctodata package?)"
 	  << endl;
-      delete set;
       return false;
     }
     else {
-      settings["default"] = set;
+      shared_ptr<LazySetting> lazy = make_shared<LazySetting>( set );
+      settings["default"] = lazy;
       default_language = "default";
       auto pos = fname.find(config_prefix());
       if ( pos != string::npos ){
 	default_language = fname.substr(pos+10);
-	settings[default_language] = set;
+	settings[default_language] = lazy;
       }
       else if ( xmlout ){
 	LOG << " cannot determine a language. Unable to create FoLiA output."
@@ -3510,6 +4534,9 @@ namespace Tokenizer {
       DBG << "Initiating tokenizer from language list..." << endl;
     }
     data_version = get_data_version();
+    word_cache.clear();
+    config_serial = ++last_config_serial;
+    rule_matchers.clear();
     // first a quick check
     set<string> available = Setting::installed_languages();
     set<string> rejected;
@@ -3538,21 +4565,24 @@ namespace Tokenizer {
 	DBG << "init language=" << lang << endl;
       }
       string fname = config_prefix() + lang;
-      Setting *set = new Setting();
-      string add;
-      if ( default_set == 0 ){
-	add = tname;
+      if ( default_set ){
+	// read when it is first needed
+	settings[lang] = make_shared<LazySetting>( fname, "" );
+	continue;
       }
-      if ( !set->read( fname, add, tokDebug, theErrLog, theDbgLog ) ){
+      // the first one is the default, which we need anyway. It gets the
+      // additional tokens too
+      shared_ptr<const Setting> set = Setting::acquire( fname, tname, tokDebug,
+							theErrLog, theDbgLog );
+      if ( !set ){
 	LOG << "problem reading datafile for language: " << lang << endl;
       }
       else {
-	if ( default_set == 0 ){
-	  default_set = set;
-	  settings["default"] = set;
-	  default_language = lang;
-	}
-	settings[lang] = set;
+	default_set = set.get();
+	shared_ptr<LazySetting> lazy = make_shared<LazySetting>( set );
+	settings["default"] = lazy;
+	settings[lang] = lazy;
+	default_language = lang;
       }
     }
     if ( settings.empty() ){
@@ -3569,20 +4599,177 @@ namespace Tokenizer {
     // examine the assigned languages of ALL tokens.
     // they should all be the same
     // assign that value
-    string result = "default";
+    const Token *result = 0;
     for ( const auto& t : tv ){
-      if ( !t.lang_code.empty() && t.lang_code != "default" ){
-	if ( result == "default" ){
-	  result = t.lang_code;
+      if ( t.lang_symbol() != no_language
+	   && t.lang_symbol() != default_language_symbol ){
+	if ( !result ){
+	  result = &t;
 	}
-	if ( result != t.lang_code ){
+	if ( result->lang_symbol() != t.lang_symbol() ){
 	  throw logic_error( "ucto: conflicting language(s) assigned" );
 	}
       }
     }
+    return result ? result->lang_code() : "default";
+  }
+
+  const UnicodeString RuleProfile::NO_MATCH = "(no match)";
+
+  vector<RuleProfile> TokenizerClass::getRuleProfile() const {
+    /// collect the profiling data of all rules
+    /*!
+      \return a list of RuleProfile records, sorted on the time spent,
+      the most expensive first.
+
+      Only words that are not served from the word cache are counted.
+    */
+    vector<RuleProfile> result;
+    for ( const auto& it : rule_profile ){
+      const Setting *set = it.first;
+      string language;
+      for ( const auto& s : settings ){
+	if ( s.second
+	     && s.second->peek() == set
+	     && ( language.empty() || language == "default" ) ){
+	  language = s.first;
+	}
+      }
+      for ( size_t r=0; r < it.second.size(); ++r ){
+	RuleProfile prof = it.second[r];
+	if ( prof.attempts == 0 && prof.skipped == 0 ){
+	  continue;
+	}
+	prof.language = language;
+	prof.id = ( r < set->rules.size() ) ? set->rules[r]->id
+	  : RuleProfile::NO_MATCH;
+	result.push_back( prof );
+      }
+    }
+    stable_sort( result.begin(), result.end(),
+		 []( const RuleProfile& p1, const RuleProfile& p2 ){
+		   return p1.nanoseconds > p2.nanoseconds; } );
     return result;
   }
 
+  void add_rule_profile( vector<RuleProfile>& profile,
+			 const vector<RuleProfile>& more ){
+    /// add profiling data to a list of profiles
+    /*!
+      \param profile the list to extend
+      \param more the profiles to add. The counts of a rule of a language
+      that is in the list already are added to it, the others are appended
+    */
+    for ( const auto& prof : more ){
+      auto it = find_if( profile.begin(), profile.end(),
+			 [&prof]( const RuleProfile& p ){
+			   return p.language == prof.language
+			     && p.id == prof.id; } );
+      if ( it == profile.end() ){
+	profile.push_back( prof );
+      }
+      else {
+	it->attempts += prof.attempts;
+	it->matches += prof.matches;
+	it->skipped += prof.skipped;
+	it->nanoseconds += prof.nanoseconds;
+      }
+    }
+  }
+
+  void print_rule_profile( ostream& os, vector<RuleProfile> profile ){
+    /// print a table with profiling data
+    /*!
+      \param os the output stream
+      \param profile the profiles of the rules
+    */
+    stable_sort( profile.begin(), profile.end(),
+		 []( const RuleProfile& p1, const RuleProfile& p2 ){
+		   return p1.nanoseconds > p2.nanoseconds; } );
+    os << "rule profile (most expensive first):" << endl;
+    os << left << setw(8) << "lang" << setw(24) << "rule"
+       << right << setw(10) << "attempts" << setw(10) << "matches"
+       << setw(10) << "skipped" << setw(12) << "total ms"
+       << setw(12) << "ns/attempt" << endl;
+    for ( const auto& prof : profile ){
+      os << left << setw(8) << prof.language
+	 << setw(24) << TiCC::UnicodeToUTF8( prof.id )
+	 << right << setw(10) << prof.attempts
+	 << setw(10) << prof.matches
+	 << setw(10) << prof.skipped
+	 << setw(12) << fixed << setprecision(3)
+	 << prof.nanoseconds / 1.0e6
+	 << setw(12) << ( prof.attempts ? prof.nanoseconds / prof.attempts : 0 )
+	 << endl;
+    }
+  }
+
+  void TokenizerClass::printRuleProfile( ostream& os ) const {
+    /// print a table with the profiling data of all rules
+    /*!
+      \param os the output stream
+    */
+    print_rule_profile( os, getRuleProfile() );
+  }
+
+  bool TokenizerClass::save_compiled_settings() const {
+    /// save all settings in compiled form, in the local cachedir
+    /*!
+      \return true on succes
+
+      A next init() for the same configuration will use these, as long as
+      they are newer than the configuration files. With language detection,
+      the fingerprints of the languages are saved as well.
+    */
+    set<const Setting*> done;
+    for ( const auto& it : settings ){
+      // all of them, also the ones not used yet
+      const Setting *set = it.second
+	? it.second->get( tokDebug, theErrLog, theDbgLog ) : 0;
+      if ( !set
+	   || set->source_files.empty()
+	   || !done.insert( set ).second ){
+	continue;
+      }
+      string name = Setting::compiled_name( set->source_files.front(),
+					    set->add_tokens_file );
+      if ( !TiCC::createPath( TiCC::dirname( name ) + "/" )
+	   || !set->save_compiled( name ) ){
+	LOG << "unable to save compiled settings in: " << name << endl;
+	return false;
+      }
+      LOG << "saved compiled settings in: " << name << endl;
+    }
+    if ( lang_id ){
+      const string& cfg = lang_id->config();
+      string name = LanguageIdentifier::compiled_name( cfg );
+      if ( !LanguageIdentifier::save_compiled( cfg, theErrLog ) ){
+	LOG << "unable to save compiled fingerprints in: " << name << endl;
+	return false;
+      }
+      LOG << "saved compiled fingerprints in: " << name << endl;
+    }
+    return true;
+  }
+
+  const Setting *TokenizerClass::get_setting( const string& language ) const {
+    /// the Setting for a language, which is read when first asked for
+    /*!
+      \param language the language
+      \return the Setting, or 0 when the language is unknown, "und", or
+      its datafile can't be read
+
+      Threads sharing our settings (sessions) may call this at the same
+      time.
+    */
+    auto const it = settings.find( language );
+    if ( it == settings.end()
+	 || !it->second ){
+      return 0;
+    }
+    return it->second->get( tokDebug, theErrLog, theDbgLog );
+  }
+
   bool TokenizerClass::get_setting_info( const std::string& language,
 					 std::string& set_file,
 					 std::string& version ) const {
@@ -3593,8 +4780,8 @@ namespace Tokenizer {
       return false;
     }
     else {
-      set_file = it->second->set_file;
-      version = it->second->version;
+      set_file = it->second->name();
+      version = it->second->version();
       return true;
     }
   }
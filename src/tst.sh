@@ -1,4 +1,5 @@
 #! /bin/sh
 
 ./ucto -c $srcdir/../tests/tst.cfg $srcdir/../tests/tst.txt tst.out
-diff tst.out $srcdir/../tests/tst.ok
+diff tst.out $srcdir/../tests/tst.ok || exit 1
+./tsttokenize $srcdir/../tests/tst.cfg
@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+*/
+
+// Checks that TokenizerClass::tokenize( text, options ) may be called from
+// several threads at once: every thread must get the same sentences as
+// tokenizeOneSentence() gives for the same text.
+//
+// usage: tsttokenize <configfile>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include "ticcutils/Unicode.h"
+#include "ucto/tokenize.h"
+
+using namespace std;
+using namespace Tokenizer;
+
+const size_t THREADS = 6;
+const size_t ROUNDS = 50;
+
+const vector<string> texts = {
+  "This is a test on date 29-10-2011!",
+  "A line with two sentences! And a second one, on 1-1-2000!",
+  "A paragraph that runs\nover several lines!\n\nAnd a second paragraph,\nwithout an end",
+  "\"A quote!\" he said, on 12-12-1982! (And some more.)",
+  "No end marker at all",
+  "Short! Shorter! Shortest!"
+};
+
+typedef vector<vector<string>> sentences;
+
+vector<string> show( const vector<Token>& sentence ){
+  vector<string> result;
+  for ( const auto& token : sentence ){
+    ostringstream os;
+    os << token;
+    result.push_back( os.str() );
+  }
+  return result;
+}
+
+sentences reference( TokenizerClass& tokenizer, const string& text ){
+  // the sentences the stream API gives
+  tokenizer.reset();
+  istringstream in( text );
+  sentences result;
+  vector<Token> sentence = tokenizer.tokenizeOneSentence( in );
+  while ( !sentence.empty() ){
+    result.push_back( show( sentence ) );
+    sentence = tokenizer.tokenizeOneSentence( in );
+  }
+  return result;
+}
+
+int main( int argc, char *argv[] ){
+  if ( argc != 2 ){
+    cerr << "usage: " << argv[0] << " <configfile>" << endl;
+    return EXIT_FAILURE;
+  }
+  TokenizerClass expected_tokenizer;
+  TokenizerClass tokenizer;
+  if ( !expected_tokenizer.init( argv[1] )
+       || !tokenizer.init( argv[1] ) ){
+    cerr << "initializing from " << argv[1] << " failed" << endl;
+    return EXIT_FAILURE;
+  }
+  vector<sentences> expected;
+  for ( const auto& text : texts ){
+    expected.push_back( reference( expected_tokenizer, text ) );
+  }
+  atomic<size_t> mismatches( 0 );
+  atomic<size_t> compared( 0 );
+  vector<thread> pool;
+  for ( size_t t=0; t < THREADS; ++t ){
+    pool.emplace_back( [&,t](){
+	for ( size_t r=0; r < ROUNDS; ++r ){
+	  // every thread takes the texts in another order
+	  for ( size_t i=0; i < texts.size(); ++i ){
+	    const size_t n = ( i + t + r ) % texts.size();
+	    sentences result;
+	    for ( const auto& sentence :
+		    tokenizer.tokenize( TiCC::UnicodeFromUTF8( texts[n] ) ) ){
+	      result.push_back( show( sentence ) );
+	    }
+	    ++compared;
+	    if ( result != expected[n] ){
+	      ++mismatches;
+	    }
+	  }
+	}
+      } );
+  }
+  for ( auto& t : pool ){
+    t.join();
+  }
+  if ( mismatches > 0 ){
+    cerr << mismatches << " of " << compared << " texts differ" << endl;
+    return EXIT_FAILURE;
+  }
+  cout << compared << " texts tokenized on " << THREADS
+       << " threads, no differences" << endl;
+  return EXIT_SUCCESS;
+}
@@ -32,6 +32,15 @@
 #include <set>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <sstream>
+#include <csignal>
+#include <cerrno>
 #include "ticcutils/StringOps.h"
 #include "libfolia/folia.h"
 #include "ticcutils/CommandLine.h"
@@ -42,6 +51,13 @@
 #include "ucto/setting.h"
 #include "ucto/tokenize.h"
 #include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 using namespace std;
 using namespace Tokenizer;
@@ -93,10 +109,19 @@ void usage(){
        << "Options:" << endl
        << "\t-c <configfile>   - Explicitly specify a configuration file" << endl
        << "\t-B                - Run in batch mode. Requires at least -O" << endl
-       << "\t-I <inpdir>       - the input directory to find input files (batch mode only) " << endl
+       << "\t-j <n>            - use n threads (default 1). In batch mode n files are" << endl
+      << "\t                    tokenized at the same time, otherwise the input is" << endl
+      << "\t                    split at empty lines" << endl
+       << "\t--pipeline        - read, tokenize and write on separate threads" << endl
+       << "\t--server=<address> - keep running, and tokenize the texts that clients send." << endl
+       << "\t                    address is a port number (TCP on localhost only)" << endl
+       << "\t                    or the path of a Unix domain socket. -j gives the" << endl
+       << "\t                    number of worker threads" << endl
+      << "\t-I <inpdir>       - the input directory to find input files (batch mode only) " << endl
        << "\t-O <outdir>       - the output directory to stored results. (required for batch mode)" << endl
        << "\t-d <value>        - set debug level" << endl
        << "\t-e <string>       - set input encoding (default UTF8)" << endl
+       << "\t--invalid-utf8=[replace|skip] - replace ill-formed UTF-8 by U+FFFD, or skip the lines containing it (default replace)" << endl
        << "\t-N <string>       - set output normalization (default NFC)" << endl
        << "\t--filter=[YES|NO] - Disable filtering of special characters" << endl
        << "\t-h or --help      - this message" << endl
@@ -114,6 +139,10 @@ void usage(){
        << "\t-v                - Verbose mode" << endl
        << "\t-s <string>       - End-of-Sentence marker (default: <utt>)" << endl
        << "\t--passthru        - Don't tokenize, but perform input decoding and simple token role detection" << endl
+       << "\t--compile-settings - save the settings in a compiled form, to speed up the start of next runs, and stop" << endl
+       << "\t--cache-size=<n>  - remember the tokenization of the last n distinct words (default 10000, 0 disables)" << endl
+       << "\t--cache-stats     - report the hits and misses of the word cache on stderr" << endl
+       << "\t--profile-rules   - report the number of attempts, matches and time spent per rule on stderr" << endl
        << "\t--normalize=<class1>,class2>,... " << endl
        << "\t                  - For class1, class2, etc. output the class tokens instead of the tokens itself." << endl
        << "\t-T or --textredundancy=[full|minimal|none]  - set text redundancy level for text nodes in FoLiA output: " << endl
@@ -174,6 +203,7 @@ public:
   bool sentenceperlineinput;
   bool paragraphdetection;
   bool quotedetection;
+  bool keep_quoted_spaces;
   bool do_language_detect;
   bool use_lang;
   bool detect_lang;
@@ -190,6 +220,7 @@ public:
   bool ignore_tags;
   bool sentencesplit;
   bool copyclass;
+  bool compile_settings;
   string redundancy;
   string utt_marker;
   string docid;
@@ -206,6 +237,13 @@ public:
   string add_tokens;
   string command_line;
   string separators;
+  int cache_size;
+  bool cache_stats;
+  unsigned int jobs;
+  bool profile_rules;
+  bool replace_invalid;
+  bool pipeline;
+  string server_address;
   vector<string> language_list;
   vector<string> input_files;
   vector<pair<string,string>> file_list;
@@ -220,6 +258,7 @@ runtime_opts::runtime_opts():
   sentenceperlineinput(false),
   paragraphdetection(true),
   quotedetection(false),
+  keep_quoted_spaces(false),
   do_language_detect(false),
   use_lang(false),
   detect_lang(false),
@@ -236,6 +275,7 @@ runtime_opts::runtime_opts():
   ignore_tags(false),
   sentencesplit(false),
   copyclass(false),
+  compile_settings(false),
   redundancy("minimal"),
   utt_marker("<utt>"),
   normalization("NFC"),
@@ -243,7 +283,13 @@ runtime_opts::runtime_opts():
   inputclass ("current"),
   outputclass("current"),
   command_line("ucto"),
-  separators("+")
+  separators("+"),
+  cache_size(-1),
+  cache_stats(false),
+  jobs(1),
+  profile_rules(false),
+  replace_invalid(true),
+  pipeline(false)
 {}
 
 void runtime_opts::check_xmlin_opt(){
@@ -371,8 +417,39 @@ void runtime_opts::fill( TiCC::CL_Options& Opts ){
   }
   ignore_tags = Opts.extract( "ignore-tag-hints" );
   pass_thru = Opts.extract( "passthru" );
+  compile_settings = Opts.extract( "compile-settings" );
+  if ( compile_settings && pass_thru ){
+    throw TiCC::OptionError( "--compile-settings and --passthru options conflict. Use only one of these." );
+  }
   Opts.extract("normalize", norm_set_string );
   Opts.extract( "separators", separators );
+  if ( Opts.extract( "cache-size", value ) ){
+    if ( !TiCC::stringTo( value, cache_size )
+	 || cache_size < 0 ){
+      throw TiCC::OptionError( "invalid value for --cache-size: " + value );
+    }
+  }
+  if ( Opts.extract( 'j', value ) ){
+    if ( !TiCC::stringTo( value, jobs )
+	 || jobs < 1 ){
+      throw TiCC::OptionError( "invalid value for -j: " + value );
+    }
+  }
+  cache_stats = Opts.extract( "cache-stats" );
+  profile_rules = Opts.extract( "profile-rules" );
+  pipeline = Opts.extract( "pipeline" );
+  Opts.extract( "server", server_address );
+  if ( Opts.extract( "invalid-utf8", value ) ){
+    if ( value == "replace" ){
+      replace_invalid = true;
+    }
+    else if ( value == "skip" ){
+      replace_invalid = false;
+    }
+    else {
+      throw TiCC::OptionError( "invalid value for --invalid-utf8: " + value );
+    }
+  }
   keep_quoted_spaces = Opts.extract( "keep-spaces-inside-quotes" );
   if ( keep_quoted_spaces && quotedetection ){
     throw TiCC::OptionError( "ucto: combining '--keep-spaces-inside-quotes' "
@@ -497,6 +574,20 @@ void runtime_opts::fill( TiCC::CL_Options& Opts ){
     //   cerr << "search: " << bla << endl;
     // }
   }
+  if ( !server_address.empty() ){
+    if ( batchmode ){
+      throw TiCC::OptionError( "--server and -B options conflict. Use only one of these." );
+    }
+    if ( xmlin || xmlout ){
+      throw TiCC::OptionError( "--server only handles text, not FoLiA (-F or -X)" );
+    }
+    if ( pipeline || compile_settings ){
+      throw TiCC::OptionError( "--server conflicts with --pipeline and --compile-settings" );
+    }
+    if ( !input_files.empty() ){
+      throw TiCC::OptionError( "--server takes no input or output files" );
+    }
+  }
   if ( !batchmode
        && input_files.size() > 2 ){
     string mess = "found additional arguments on the commandline: "
@@ -651,8 +742,12 @@ pair<istream *,ostream *> runtime_opts::determine_io( const pair<string,string>&
   return make_pair(IN,OUT);
 }
 
+// keeps the messages about files that are tokenized at the same time apart
+mutex message_lock;
+
 void init( TokenizerClass& tokenizer,
-	   const runtime_opts& my_options ){
+	   const runtime_opts& my_options,
+	   bool announce = true ){
   // set debug first, so init() can be debugged too
   tokenizer.setDebug( my_options.debug );
   tokenizer.set_command( my_options.command_line );
@@ -666,6 +761,7 @@ void init( TokenizerClass& tokenizer,
   tokenizer.setNormSet( my_options.norm_set_string );
   tokenizer.setParagraphDetection( my_options.paragraphdetection);
   tokenizer.setQuoteDetection( my_options.quotedetection);
+  tokenizer.setKeepQuotedSpaces( my_options.keep_quoted_spaces );
   tokenizer.setNormalization( my_options.normalization );
   tokenizer.setInputEncoding( my_options.inputEncoding );
   tokenizer.setFiltering( my_options.dofiltering );
@@ -682,6 +778,12 @@ void init( TokenizerClass& tokenizer,
   tokenizer.setUndLang( my_options.do_und_lang );
   tokenizer.setNoTags( my_options.ignore_tags );
   tokenizer.setPassThru( my_options.pass_thru );
+  if ( my_options.cache_size >= 0 ){
+    tokenizer.setWordCacheSize( my_options.cache_size );
+  }
+  tokenizer.setRuleProfiling( my_options.profile_rules );
+  tokenizer.setReplaceInvalid( my_options.replace_invalid );
+  tokenizer.setPipeline( my_options.pipeline );
   if ( !my_options.pass_thru ){
     // init from config file
     if ( !my_options.c_file.empty()
@@ -693,6 +795,10 @@ void init( TokenizerClass& tokenizer,
 			       my_options.add_tokens ) ){
       throw runtime_error( "ucto: initialize failed" );
     }
+    if ( !announce ){
+      return;
+    }
+    lock_guard<mutex> lock( message_lock );
     if ( !my_options.c_file.empty() ){
       cerr << "ucto: configured from file: " << my_options.c_file << endl;
     }
@@ -706,20 +812,587 @@ void init( TokenizerClass& tokenizer,
   }
 }
 
+void tokenize_file( runtime_opts& my_options,
+		    const pair<string,string>& io_pair,
+		    unique_ptr<TokenizerClass>& tokenizer,
+		    vector<unique_ptr<TokenizerClass>>& helpers ){
+  // tokenize one input file to its output file.
+  // A tokenizer that is initialized already, is used again. Otherwise a
+  // new one is created and initialized. The same goes for the helpers,
+  // used with -j.
+  pair<istream *,ostream *> io_streams;
+  {
+    lock_guard<mutex> lock( message_lock );
+    io_streams = my_options.determine_io( io_pair );
+  }
+  istream *IN = io_streams.first;
+  ostream *OUT = io_streams.second;
+  vector<TokenizerClass*> pointers;
+  try {
+    if ( !tokenizer ){
+      tokenizer.reset( new TokenizerClass() );
+      init( *tokenizer, my_options );
+    }
+    else {
+      tokenizer->reset();
+      // only these may differ from file to file
+      tokenizer->setXMLOutput( my_options.xmlout, my_options.docid );
+      tokenizer->setXMLInput( my_options.xmlin );
+    }
+    if ( my_options.jobs > 1
+	 && !my_options.xmlin ){
+      // split the input over my_options.jobs helpers
+      while ( helpers.size() < my_options.jobs ){
+	helpers.emplace_back( new TokenizerClass() );
+	init( *helpers.back(), my_options, false );
+      }
+      for ( const auto& helper : helpers ){
+	pointers.push_back( helper.get() );
+      }
+    }
+  }
+  catch (...){
+    tokenizer.reset();
+    helpers.clear();
+    if ( IN != &cin ){
+      delete IN;
+    }
+    if ( OUT != &cout ){
+      delete OUT;
+    }
+    throw;
+  }
+  if ( my_options.xmlin ) {
+    folia::Document *doc = tokenizer->tokenize_folia( my_options.ifile );
+    if ( doc ){
+      *OUT << doc;
+      OUT->flush();
+      delete doc;
+    }
+    if ( OUT != &cout ){
+      delete OUT;
+    }
+  }
+  else if ( !helpers.empty() ){
+    tokenizer->tokenize( *IN, *OUT, pointers );
+    if ( OUT != &cout ){
+      delete OUT;
+    }
+    if ( IN != &cin ){
+      delete IN;
+    }
+  }
+  else {
+    tokenizer->tokenize( *IN, *OUT );
+    if ( OUT != &cout ){
+      delete OUT;
+    }
+    if ( IN != &cin ){
+      delete IN;
+    }
+  }
+}
+
+// the statistics of one or more tokenizers, to report them all at once
+struct statistics {
+  size_t tokenizers = 0;
+  size_t cache_hits = 0;
+  size_t cache_misses = 0;
+  vector<RuleProfile> rule_profile;
+  void add( const TokenizerClass& );
+};
+
+void statistics::add( const TokenizerClass& tokenizer ){
+  ++tokenizers;
+  const WordCache& cache = tokenizer.getWordCache();
+  cache_hits += cache.hits();
+  cache_misses += cache.misses();
+  if ( tokenizer.getRuleProfiling() ){
+    add_rule_profile( rule_profile, tokenizer.getRuleProfile() );
+  }
+}
+
+void report( const statistics& stats,
+	     const runtime_opts& my_options ){
+  // show the statistics that were asked for
+  if ( my_options.cache_stats ){
+    size_t lookups = stats.cache_hits + stats.cache_misses;
+    if ( lookups > 0 ){
+      cerr << "ucto: word cache: " << stats.cache_hits << " hits, "
+	   << stats.cache_misses << " misses ("
+	   << ( 100.0 * stats.cache_hits ) / lookups << "% hits)" << endl;
+    }
+  }
+  if ( my_options.profile_rules ){
+    print_rule_profile( cerr, stats.rule_profile );
+  }
+}
+
+void tokenize_batch( const runtime_opts& my_options ){
+  // tokenize all files on my_options.jobs threads. Every thread takes the
+  // next file from the list, the largest first, so a few big files don't
+  // end up on one thread at the very end.
+  // Each thread initializes its tokenizer once, and keeps it for all the
+  // files it gets.
+  const vector<pair<string,string>>& files = my_options.file_list;
+  vector<pair<off_t,size_t>> order;
+  for ( size_t i=0; i < files.size(); ++i ){
+    struct stat st;
+    off_t size = 0;
+    if ( stat( files[i].first.c_str(), &st ) == 0 ){
+      size = st.st_size;
+    }
+    order.push_back( make_pair( size, i ) );
+  }
+  stable_sort( order.begin(), order.end(),
+	       []( const pair<off_t,size_t>& a, const pair<off_t,size_t>& b ){
+		 return a.first > b.first; } );
+  atomic<size_t> next( 0 );
+  // the workers add their statistics to these, to report them at once
+  statistics stats;
+  mutex stats_lock;
+  auto worker = [&](){
+    runtime_opts options = my_options;
+    // each worker only needs the options, not all the files
+    options.input_files.clear();
+    options.file_list.clear();
+    // and tokenizes its files on its own
+    options.jobs = 1;
+    unique_ptr<TokenizerClass> tokenizer;
+    vector<unique_ptr<TokenizerClass>> no_helpers;
+    size_t i;
+    while ( ( i = next++ ) < order.size() ){
+      const pair<string,string>& io_pair = files[order[i].second];
+      try {
+	// generate an ID for every document
+	options.docid.clear();
+	tokenize_file( options, io_pair, tokenizer, no_helpers );
+      }
+      catch ( exception &e ){
+	// don't trust the state of the tokenizer anymore
+	tokenizer.reset();
+	lock_guard<mutex> lock( message_lock );
+	cerr << "ucto: tokenizing '" << io_pair.first << "' to '"
+	     << io_pair.second << "' failed: " << e.what() << endl
+	     << "continue to next input." << endl;
+      }
+    }
+    if ( tokenizer ){
+      lock_guard<mutex> lock( stats_lock );
+      stats.add( *tokenizer );
+    }
+  };
+  const size_t workers = min<size_t>( my_options.jobs, order.size() );
+  vector<thread> pool;
+  for ( size_t w=0; w < workers; ++w ){
+    pool.emplace_back( worker );
+  }
+  for ( auto& t : pool ){
+    t.join();
+  }
+  if ( stats.tokenizers > 0 ){
+    report( stats, my_options );
+  }
+}
+
+// The server mode (--server). Clients send requests and get a response to
+// each one, in the same order. Both are a 4 byte length (most significant
+// byte first), followed by that many bytes:
+//   request:  a line with options, followed by the text to tokenize (UTF-8)
+//   response: a line "OK", followed by the output, or a line "ERROR: <why>"
+// The options are a part of ucto's own: -L <language>, -n, -l, -u, --split
+// and -v. They add to the options the server was started with. An empty
+// line gives just those.
+//
+// Every connection has its own thread, which reads as many requests as the
+// client has sent already (up to MAX_BATCH) and queues them for the
+// workers. A worker takes its share of the queue at once, so many small
+// requests don't cost a wakeup each. Each worker keeps a tokenizer per
+// language, which shares its settings with all others.
+
+const uint32_t MAX_REQUEST = 64*1024*1024;
+const size_t MAX_BATCH = 32;          // the most requests taken at once
+const size_t BATCH_BYTES = 64*1024;   // unless they have more text than this
+
+struct ServerRequest {
+  string options;
+  string text;
+  string response;
+};
+
+// the requests read from a connection at once
+struct RequestBatch {
+  vector<ServerRequest> requests;
+  size_t pending;
+  mutex lock;
+  condition_variable done;
+};
+
+bool read_all( int fd, char *buf, size_t len ){
+  while ( len > 0 ){
+    ssize_t n = read( fd, buf, len );
+    if ( n < 0 && errno == EINTR ){
+      continue;
+    }
+    if ( n <= 0 ){
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool write_all( int fd, const string& data ){
+  const char *buf = data.data();
+  size_t len = data.size();
+  while ( len > 0 ){
+    ssize_t n = write( fd, buf, len );
+    if ( n < 0 && errno == EINTR ){
+      continue;
+    }
+    if ( n <= 0 ){
+      return false;
+    }
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool read_request( int fd, ServerRequest& request ){
+  // read the next request of a client. false at the end of the connection
+  unsigned char head[4];
+  if ( !read_all( fd, reinterpret_cast<char*>(head), sizeof(head) ) ){
+    return false;
+  }
+  const uint32_t len = ( uint32_t(head[0]) << 24 ) | ( uint32_t(head[1]) << 16 )
+    | ( uint32_t(head[2]) << 8 ) | uint32_t(head[3]);
+  if ( len > MAX_REQUEST ){
+    return false;
+  }
+  string body( len, '\0' );
+  if ( !read_all( fd, &body[0], len ) ){
+    return false;
+  }
+  const string::size_type nl = body.find( '\n' );
+  if ( nl == string::npos ){
+    request.options = body;
+    request.text.clear();
+  }
+  else {
+    request.options = body.substr( 0, nl );
+    request.text = body.substr( nl + 1 );
+  }
+  return true;
+}
+
+void add_response( string& out, const string& response ){
+  const uint32_t len = response.size();
+  out += char( ( len >> 24 ) & 0xff );
+  out += char( ( len >> 16 ) & 0xff );
+  out += char( ( len >> 8 ) & 0xff );
+  out += char( len & 0xff );
+  out += response;
+}
+
+bool more_input( int fd ){
+  // has the client sent more already?
+  struct pollfd p;
+  p.fd = fd;
+  p.events = POLLIN;
+  return poll( &p, 1, 0 ) > 0 && ( p.revents & POLLIN );
+}
+
+int open_server_socket( const string& address ){
+  // a port number means TCP on localhost, anything else is the path of
+  // a Unix domain socket
+  int fd;
+  int port = 0;
+  if ( TiCC::stringTo( address, port ) ){
+    if ( port <= 0 || port > 65535 ){
+      throw runtime_error( "invalid port number: " + address );
+    }
+    fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( fd < 0 ){
+      throw runtime_error( string( "socket: " ) + strerror( errno ) );
+    }
+    int on = 1;
+    setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons( port );
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    if ( ::bind( fd, reinterpret_cast<struct sockaddr*>(&addr),
+		 sizeof(addr) ) != 0 ){
+      close( fd );
+      throw runtime_error( "unable to use port " + address + ": "
+			   + strerror( errno ) );
+    }
+  }
+  else {
+    struct sockaddr_un addr;
+    memset( &addr, 0, sizeof(addr) );
+    if ( address.size() >= sizeof(addr.sun_path) ){
+      throw runtime_error( "socket path too long: " + address );
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, address.c_str() );
+    struct stat st;
+    if ( lstat( address.c_str(), &st ) == 0
+	 && S_ISSOCK( st.st_mode ) ){
+      // left behind by an earlier server
+      unlink( address.c_str() );
+    }
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( fd < 0 ){
+      throw runtime_error( string( "socket: " ) + strerror( errno ) );
+    }
+    if ( ::bind( fd, reinterpret_cast<struct sockaddr*>(&addr),
+		 sizeof(addr) ) != 0 ){
+      close( fd );
+      throw runtime_error( "unable to use socket " + address + ": "
+			   + strerror( errno ) );
+    }
+  }
+  if ( listen( fd, SOMAXCONN ) != 0 ){
+    close( fd );
+    throw runtime_error( string( "listen: " ) + strerror( errno ) );
+  }
+  return fd;
+}
+
+class TokenizerServer {
+public:
+  explicit TokenizerServer( const runtime_opts& );
+  void run();
+private:
+  typedef map<string,unique_ptr<TokenizerClass>> TokenizerMap;
+  void worker();
+  void serve_connection( int );
+  void handle( TokenizerMap&, ServerRequest& );
+  TokenizerClass& get_tokenizer( TokenizerMap&, const string& );
+  const runtime_opts& options;
+  string default_language;
+  // the tokenizers made at the start, which keep the settings loaded
+  TokenizerMap resident;
+  mutex queue_lock;
+  condition_variable queue_filled;
+  deque<pair<RequestBatch*,size_t>> queue;
+};
+
+TokenizerServer::TokenizerServer( const runtime_opts& opts ):
+  options( opts )
+{
+  // load all languages now, so problems show up before we start serving
+  if ( options.c_file.empty() && !options.language_list.empty() ){
+    default_language = options.language_list.front();
+    for ( const auto& lang : options.language_list ){
+      if ( lang != "und" ){
+	get_tokenizer( resident, lang );
+      }
+    }
+  }
+  else {
+    get_tokenizer( resident, "" );
+  }
+}
+
+TokenizerClass& TokenizerServer::get_tokenizer( TokenizerMap& tokenizers,
+						const string& language ){
+  // the tokenizer for a language, which is created when first asked for.
+  // "" is the default: the configfile or the first language
+  unique_ptr<TokenizerClass>& tokenizer = tokenizers[language];
+  if ( !tokenizer ){
+    runtime_opts lang_options = options;
+    if ( !language.empty() ){
+      lang_options.language_list = { language };
+    }
+    tokenizer.reset( new TokenizerClass() );
+    init( *tokenizer, lang_options, false );
+  }
+  return *tokenizer;
+}
+
+void TokenizerServer::handle( TokenizerMap& tokenizers,
+			      ServerRequest& request ){
+  string language;
+  bool per_line = options.sentenceperlineoutput;
+  bool lower = options.tolowercase;
+  bool upper = options.touppercase;
+  bool split = options.sentencesplit;
+  bool verbose = options.verbose;
+  vector<string> words = TiCC::split( request.options );
+  for ( size_t i=0; i < words.size(); ++i ){
+    if ( words[i] == "-L" && i+1 < words.size() ){
+      language = fix_639_1( words[++i] );
+    }
+    else if ( words[i] == "-n" ){
+      per_line = true;
+    }
+    else if ( words[i] == "-l" ){
+      lower = true;
+    }
+    else if ( words[i] == "-u" ){
+      upper = true;
+    }
+    else if ( words[i] == "--split" ){
+      split = true;
+    }
+    else if ( words[i] == "-v" ){
+      verbose = true;
+    }
+    else {
+      throw runtime_error( "unsupported option: " + words[i] );
+    }
+  }
+  if ( language.empty()
+       || language == default_language ){
+    language.clear();
+  }
+  else if ( language == "und"
+	    || find( options.language_list.begin(),
+		     options.language_list.end(),
+		     language ) == options.language_list.end() ){
+    throw runtime_error( "language not available: " + language );
+  }
+  TokenizerClass& tokenizer = get_tokenizer( tokenizers, language );
+  tokenizer.setSentencePerLineOutput( per_line );
+  tokenizer.setLowercase( lower );
+  tokenizer.setUppercase( upper );
+  tokenizer.setSentenceSplit( split );
+  tokenizer.setVerbose( verbose );
+  tokenizer.reset();
+  istringstream in( request.text );
+  ostringstream out;
+  tokenizer.tokenize( in, out );
+  request.response = "OK\n" + out.str();
+}
+
+void TokenizerServer::worker(){
+  TokenizerMap tokenizers;
+  vector<pair<RequestBatch*,size_t>> taken;
+  while ( true ){
+    {
+      unique_lock<mutex> lock( queue_lock );
+      queue_filled.wait( lock, [this]{ return !queue.empty(); } );
+      // take our share, and leave the rest to the other workers
+      const size_t share = min( MAX_BATCH,
+				( queue.size() + options.jobs - 1 ) / options.jobs );
+      size_t bytes = 0;
+      while ( !queue.empty()
+	      && taken.size() < share
+	      && bytes < BATCH_BYTES ){
+	taken.push_back( queue.front() );
+	queue.pop_front();
+	bytes += taken.back().first->requests[taken.back().second].text.size();
+      }
+    }
+    for ( const auto& it : taken ){
+      RequestBatch *batch = it.first;
+      ServerRequest& request = batch->requests[it.second];
+      try {
+	handle( tokenizers, request );
+      }
+      catch ( exception& e ){
+	request.response = string( "ERROR: " ) + e.what() + "\n";
+      }
+      lock_guard<mutex> lock( batch->lock );
+      if ( --batch->pending == 0 ){
+	batch->done.notify_one();
+      }
+    }
+    taken.clear();
+  }
+}
+
+void TokenizerServer::serve_connection( int fd ){
+  RequestBatch batch;
+  bool at_end = false;
+  while ( !at_end ){
+    batch.requests.clear();
+    size_t bytes = 0;
+    do {
+      batch.requests.emplace_back();
+      if ( !read_request( fd, batch.requests.back() ) ){
+	batch.requests.pop_back();
+	at_end = true;
+	break;
+      }
+      bytes += batch.requests.back().text.size();
+    } while ( batch.requests.size() < MAX_BATCH
+	      && bytes < BATCH_BYTES
+	      && more_input( fd ) );
+    if ( batch.requests.empty() ){
+      break;
+    }
+    batch.pending = batch.requests.size();
+    {
+      lock_guard<mutex> lock( queue_lock );
+      for ( size_t i=0; i < batch.requests.size(); ++i ){
+	queue.push_back( make_pair( &batch, i ) );
+      }
+    }
+    queue_filled.notify_all();
+    {
+      unique_lock<mutex> lock( batch.lock );
+      batch.done.wait( lock, [&batch]{ return batch.pending == 0; } );
+    }
+    string out;
+    for ( const auto& request : batch.requests ){
+      add_response( out, request.response );
+    }
+    if ( !write_all( fd, out ) ){
+      break;
+    }
+  }
+  close( fd );
+}
+
+void TokenizerServer::run(){
+  // serve until we are killed
+  signal( SIGPIPE, SIG_IGN ); // a client that is gone is no reason to stop
+  int listen_fd = open_server_socket( options.server_address );
+  int port;
+  const bool tcp = TiCC::stringTo( options.server_address, port );
+  for ( size_t w=0; w < options.jobs; ++w ){
+    thread( &TokenizerServer::worker, this ).detach();
+  }
+  cerr << "ucto: serving on " << options.server_address << " with "
+       << options.jobs << " worker(s)" << endl;
+  while ( true ){
+    int fd = accept( listen_fd, 0, 0 );
+    if ( fd < 0 ){
+      if ( errno == EINTR || errno == ECONNABORTED ){
+	continue;
+      }
+      throw runtime_error( string( "accept: " ) + strerror( errno ) );
+    }
+    if ( tcp ){
+      // small requests and answers, don't wait to fill a packet
+      int on = 1;
+      setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+    }
+    thread( &TokenizerServer::serve_connection, this, fd ).detach();
+  }
+}
+
 int main( int argc, char *argv[] ){
   runtime_opts my_options;
   for ( int i=1; i < argc; ++i ){
     my_options.command_line += " " + string(argv[i]);
   }
   try {
-    TiCC::CL_Options Opts( "Bd:e:fhlI:O:PQunmN:vVL:c:s:x:FXT:",
+    TiCC::CL_Options Opts( "Bd:e:fhj:lI:O:PQunmN:vVL:c:s:x:FXT:",
 			   "filter:,filterpunct,passthru,textclass:,copyclass,"
 			   "inputclass:,outputclass:,normalize:,id:,version,"
 			   "help,detectlanguages:,uselanguages:,"
 			   "textredundancy:,add-tokens:,split,"
 			   "allow-word-corrections,ignore-tag-hints,"
 			   "keep-spaces-inside-quotes,"
-			   "separators:");
+			   "separators:,cache-size:,cache-stats,compile-settings,invalid-utf8:,"
+			   "profile-rules,pipeline,server:");
     Opts.init(argc, argv );
     if ( Opts.extract( 'h' )
 	 || Opts.extract( "help" ) ){
@@ -742,51 +1415,64 @@ int main( int argc, char *argv[] ){
     usage_small();
     return EXIT_FAILURE;
   }
-  for ( const auto& io_pair : my_options.file_list ){
+  if ( my_options.compile_settings ){
     try {
-      pair<istream *,ostream *> io_streams;
-      io_streams = my_options.determine_io( io_pair );
-      istream *IN = io_streams.first;
-      ostream *OUT = io_streams.second;
       TokenizerClass tokenizer;
-      try {
-	init( tokenizer, my_options );
-      }
-      catch (...){
-	if ( IN != &cin ){
-	  delete IN;
-	}
-	if ( OUT != &cout ){
-	  delete OUT;
-	}
-	throw;
-      }
-      if ( my_options.xmlin ) {
-	folia::Document *doc = tokenizer.tokenize_folia( my_options.ifile );
-	if ( doc ){
-	  *OUT << doc;
-	  OUT->flush();
-	  delete doc;
-	}
-	if ( OUT != &cout ){
-	  delete OUT;
-	}
-      }
-      else {
-	tokenizer.tokenize( *IN, *OUT );
-	if ( OUT != &cout ){
-	  delete OUT;
-	}
-	if ( IN != &cin ){
-	  delete IN;
-	}
+      // no document is created, but init() insists on a valid ID
+      my_options.docid = "untitleddoc";
+      init( tokenizer, my_options );
+      return tokenizer.save_compiled_settings() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch ( exception &e ){
+      cerr << "ucto: compiling the settings failed: " << e.what() << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if ( !my_options.server_address.empty() ){
+    try {
+      // no document is created, but init() insists on a valid ID
+      my_options.docid = "untitleddoc";
+      TokenizerServer server( my_options );
+      server.run();
+    }
+    catch ( exception &e ){
+      cerr << "ucto: server failed: " << e.what() << endl;
+    }
+    return EXIT_FAILURE;
+  }
+  if ( my_options.batchmode
+       && my_options.jobs > 1 ){
+    tokenize_batch( my_options );
+    return EXIT_SUCCESS;
+  }
+  // initialize only once, and reset between the files
+  unique_ptr<TokenizerClass> tokenizer;
+  vector<unique_ptr<TokenizerClass>> helpers;
+  for ( const auto& io_pair : my_options.file_list ){
+    try {
+      if ( my_options.batchmode ){
+	// generate an ID for every document
+	my_options.docid.clear();
       }
+      tokenize_file( my_options, io_pair, tokenizer, helpers );
     }
     catch ( exception &e ){
+      // don't trust the state of the tokenizers anymore
+      tokenizer.reset();
+      helpers.clear();
       cerr << "ucto: tokenizing '" << io_pair.first << "' to '"
 	   << io_pair.second << "' failed: " << e.what() << endl
 	   << "continue to next input." << endl;
     }
   }
+  if ( tokenizer ){
+    // with -j, the helpers did most of the work
+    statistics stats;
+    stats.add( *tokenizer );
+    for ( const auto& helper : helpers ){
+      stats.add( *helper );
+    }
+    report( stats, my_options );
+  }
 
 }
@@ -0,0 +1,157 @@
+/*
+  Copyright (c) 2006 - 2026
+  CLST - Radboud University
+  ILK  - Tilburg University
+
+  This file is part of Ucto
+
+  Ucto is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 3 of the License, or
+  (at your option) any later version.
+
+  Ucto is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+  For questions and suggestions, see:
+      https://github.com/LanguageMachines/ucto/issues
+  or send mail to:
+      lamasoftware (at ) science.ru.nl
+
+*/
+
+#include <cstring>
+#include "unicode/locid.h"
+#include "unicode/utf8.h"
+#include "unicode/utf16.h"
+#include "ucto/writer.h"
+
+using namespace std;
+using namespace icu;
+
+namespace Tokenizer {
+
+  namespace {
+
+    bool ascii_casing_ok(){
+      // only for Turkish and Azeri the case of ASCII letters is special
+      // (I and dotless i, İ and i)
+      const char *lang = Locale::getDefault().getLanguage();
+      return strcmp( lang, "tr" ) != 0 && strcmp( lang, "az" ) != 0;
+    }
+
+  }
+
+  OutputWriter::OutputWriter():
+    out( 0 )
+  {
+    /// create a writer that keeps all output, see str()
+  }
+
+  OutputWriter::OutputWriter( ostream& os ):
+    out( &os )
+  {
+    /// create a writer for a stream
+    /*!
+      \param os the stream to write to
+    */
+    buffer.reserve( BUFFER_SIZE + BUFFER_SIZE/4 );
+  }
+
+  OutputWriter::~OutputWriter(){
+    flush();
+  }
+
+  void OutputWriter::flush(){
+    /// write the buffer to the stream, if there is one
+    if ( out && !buffer.empty() ){
+      out->write( buffer.data(), buffer.size() );
+      buffer.clear();
+    }
+  }
+
+  void OutputWriter::put( const UnicodeString& us ){
+    /// add a string, converted to UTF-8
+    /*!
+      \param us the string
+    */
+    const UChar *s = us.getBuffer();
+    const int32_t len = us.length();
+    size_t n = buffer.size();
+    // every code unit gives at most 3 bytes
+    buffer.resize( n + 3*len );
+    uint8_t *bytes = reinterpret_cast<uint8_t*>( &buffer[0] );
+    int32_t i = 0;
+    while ( i < len ){
+      if ( s[i] < 0x80 ){
+	bytes[n++] = s[i++];
+	continue;
+      }
+      UChar32 c;
+      U16_NEXT( s, i, len, c );
+      if ( U_IS_SURROGATE( c ) ){
+	c = 0xFFFD;
+      }
+      U8_APPEND_UNSAFE( bytes, n, c );
+    }
+    buffer.resize( n );
+  }
+
+  void OutputWriter::put_lower( const UnicodeString& us ){
+    /// add a string in lowercase, converted to UTF-8
+    /*!
+      \param us the string
+
+      Pure ASCII strings, the most common, are mapped here. Others are
+      left to ICU.
+    */
+    static const bool ascii_ok = ascii_casing_ok();
+    if ( ascii_ok ){
+      const size_t n = buffer.size();
+      const UChar *s = us.getBuffer();
+      const int32_t len = us.length();
+      int32_t i = 0;
+      for ( ; i < len && s[i] < 0x80; ++i ){
+	const char c = s[i];
+	buffer += ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+      }
+      if ( i == len ){
+	return;
+      }
+      buffer.resize( n );
+    }
+    put( UnicodeString( us ).toLower() );
+  }
+
+  void OutputWriter::put_upper( const UnicodeString& us ){
+    /// add a string in uppercase, converted to UTF-8
+    /*!
+      \param us the string
+
+      Pure ASCII strings, the most common, are mapped here. Others are
+      left to ICU.
+    */
+    static const bool ascii_ok = ascii_casing_ok();
+    if ( ascii_ok ){
+      const size_t n = buffer.size();
+      const UChar *s = us.getBuffer();
+      const int32_t len = us.length();
+      int32_t i = 0;
+      for ( ; i < len && s[i] < 0x80; ++i ){
+	const char c = s[i];
+	buffer += ( c >= 'a' && c <= 'z' ) ? c - ( 'a' - 'A' ) : c;
+      }
+      if ( i == len ){
+	return;
+      }
+      buffer.resize( n );
+    }
+    put( UnicodeString( us ).toUpper() );
+  }
+
+} // namespace Tokenizer
@@ -18,7 +18,9 @@ for file in testusage testlanguage testconf1 testconf2 testinclude \
 	    testtokens testoption-P testoption-split testissue64 testissue66 \
 	    testissue71 testissue72 testissue70 testnbsp testcorrect \
 	    testtag testissue81 testissue83 testissue84 testissue87 \
-	    testissue68 testissue93 testoption-m testbatch
+	    testissue68 testissue93 testoption-m testoption-cache testcompile testbatch \
+	    testprofile testinvalid testparallel testpipeline \
+	    testserver testdetect
 do
    ./testone.sh $file
    if [ $? -ne 0 ]; then
@@ -40,4 +40,19 @@ $folialint --nooutput batch_out4/folia4.ucto.xml 2>&1
 cat < batch_out/testpunctuation.ucto.txt 2>&1 # must not be present!
 $folialint --nooutput batch_out4/folia8.ucto.xml 2>&1
 
+echo "Step 6"
+$exe -L nld -B -j 1 test.nl.txt testpunctuation.txt multilang.txt -O batch_out6 2> /dev/null
+$exe -L nld -B -j 2 test.nl.txt testpunctuation.txt multilang.txt -O batch_out7 2> /dev/null
+diff -r batch_out6 batch_out7 && echo "-j 2 equals -j 1"
+$exe -L nld -B -X -j 1 test.nl.txt testpunctuation.txt multilang.txt -O batch_out8 2> /dev/null
+$exe -L nld -B -X -j 2 test.nl.txt testpunctuation.txt multilang.txt -O batch_out9 2> /dev/null
+diff -r batch_out8 batch_out9 && echo "-X -j 2 equals -X -j 1"
+for f in test.nl testpunctuation multilang; do
+    grep -m1 -o 'xml:id="[^"]*"' batch_out9/$f.txt.ucto.xml
+done
+
+echo "Step 7"
+# one report for all workers
+$exe -L nld -B -j 2 --profile-rules test.nl.txt testpunctuation.txt -O batch_out10 2>&1 | grep -c "rule profile"
+
 echo "Done"
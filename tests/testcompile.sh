@@ -0,0 +1,12 @@
+#/bin/sh
+
+export XDG_CACHE_HOME=`pwd`/testoutput/cache
+\rm -rf $XDG_CACHE_HOME
+
+$exe -c tst.cfg tst.txt
+
+$exe -c tst.cfg --compile-settings 2> /dev/null
+
+$exe -d 1 -c tst.cfg tst.txt 2>&1 | grep -c "using compiled settings"
+
+$exe -c tst.cfg tst.txt
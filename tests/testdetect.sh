@@ -0,0 +1,16 @@
+#/bin/sh
+
+# one sentence per line, in several languages. A sentence in the default
+# language (the first one) gets no <lang>
+$exe --detectlanguages=nld,eng,deu,fra -X --id=detect detect.txt testoutput/detect.xml
+$folialint --nooutput testoutput/detect.xml 2>&1
+python3 - testoutput/detect.xml <<'PYTHON'
+import sys
+import xml.etree.ElementTree as ET
+
+F = "{http://ilk.uvt.nl/folia}"
+sentences = ET.parse(sys.argv[1]).getroot().iter(F + "s")
+for n, s in enumerate(sentences, 1):
+    lang = s.find(F + "lang")
+    print(n, lang.get("class") if lang is not None else "default")
+PYTHON
@@ -0,0 +1,10 @@
+#/bin/sh
+
+# invalid.nl.txt has ill-formed UTF-8 in line 2 (bytes 33 and 34) and in
+# line 3 (byte 51)
+echo "replace"
+$exe -L nld invalid.nl.txt 2> testoutput/invalid.err
+grep "UTF-8" testoutput/invalid.err
+echo "skip"
+$exe -L nld --invalid-utf8=skip invalid.nl.txt 2> testoutput/invalid.err
+grep "UTF-8" testoutput/invalid.err
@@ -0,0 +1,7 @@
+#/bin/sh
+
+$exe -Lnl --cache-size=0 testpunctuation.txt
+
+$exe -Lnl --cache-size=1 testpunctuation.txt
+
+$exe -Lnl --cache-size=1 --filterpunct testpunctuation.txt
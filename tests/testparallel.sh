@@ -0,0 +1,23 @@
+#/bin/sh
+
+# large enough to be split in several chunks with -j
+\rm -f testoutput/parallel.big.txt
+i=0
+while [ $i -lt 3000 ]; do
+    cat parallel.nl.txt >> testoutput/parallel.big.txt
+    i=$(($i + 1))
+done
+
+$exe -L nld testoutput/parallel.big.txt testoutput/parallel.j1.txt 2> /dev/null
+$exe -L nld -j 4 testoutput/parallel.big.txt testoutput/parallel.j4.txt 2> /dev/null
+cmp testoutput/parallel.j1.txt testoutput/parallel.j4.txt && echo "-j 4 equals -j 1"
+$exe -L nld -n testoutput/parallel.big.txt testoutput/parallel.n1.txt 2> /dev/null
+$exe -L nld -n -j 4 testoutput/parallel.big.txt testoutput/parallel.n4.txt 2> /dev/null
+cmp testoutput/parallel.n1.txt testoutput/parallel.n4.txt && echo "-n -j 4 equals -n -j 1"
+# the statistics of the helpers count too
+for j in 1 4; do
+    $exe -L nld -j $j --cache-stats testoutput/parallel.big.txt testoutput/parallel.s$j.txt 2>&1 | grep "word cache" | awk '{ print "-j", '$j', "word cache lookups:", $4 + $6 }'
+    $exe -L nld -j $j --profile-rules testoutput/parallel.big.txt testoutput/parallel.p$j.txt 2>&1 | grep "^nld" | cut -c1-62 | sort > testoutput/parallel.p$j.prof
+done
+cmp testoutput/parallel.p1.prof testoutput/parallel.p4.prof && echo "-j 4 rule profile equals -j 1"
+$exe -L nld parallel.nl.txt
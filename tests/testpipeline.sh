@@ -0,0 +1,8 @@
+#/bin/sh
+
+$exe -L nld test.nl.txt testoutput/pipeline.1.txt 2> /dev/null
+$exe -L nld --pipeline test.nl.txt testoutput/pipeline.2.txt 2> /dev/null
+cmp testoutput/pipeline.1.txt testoutput/pipeline.2.txt && echo "--pipeline equals normal output"
+$exe -L nld -n --filterpunct testpunctuation.txt testoutput/pipeline.3.txt 2> /dev/null
+$exe -L nld -n --filterpunct --pipeline testpunctuation.txt testoutput/pipeline.4.txt 2> /dev/null
+cmp testoutput/pipeline.3.txt testoutput/pipeline.4.txt && echo "-n --pipeline equals -n"
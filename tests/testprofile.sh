@@ -0,0 +1,5 @@
+#/bin/sh
+
+# every word must be counted, also the repeated ones that the word cache
+# would have known. The times vary, so leave them out
+$exe -L nld --profile-rules profile.nl.txt 2>&1 > /dev/null | grep "^nld" | cut -c1-62 | sort
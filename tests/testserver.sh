@@ -0,0 +1,79 @@
+#/bin/sh
+
+sock=testoutput/ucto.sock
+\rm -f $sock
+$exe -L nld --server=$sock 2> testoutput/server.err &
+pid=$!
+i=0
+while [ ! -S $sock ] && [ $i -lt 50 ]; do
+    sleep 0.2
+    i=$(($i + 1))
+done
+
+python3 - $sock <<'PYTHON'
+import socket
+import struct
+import sys
+
+def connect():
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(sys.argv[1])
+    return s
+
+def read_all(s, n):
+    data = b""
+    while len(data) < n:
+        try:
+            part = s.recv(n - len(data))
+        except ConnectionResetError:
+            part = b""
+        if not part:
+            return None
+        data += part
+    return data
+
+def receive(s):
+    head = read_all(s, 4)
+    if head is None:
+        return "connection closed"
+    return read_all(s, struct.unpack(">I", head)[0]).decode("utf-8")
+
+def request(s, body):
+    body = body.encode("utf-8")
+    s.sendall(struct.pack(">I", len(body)) + body)
+
+print("round trip")
+s = connect()
+request(s, "\nDit is een test. Het werkt!\n")
+request(s, "-n -l\nDit is een test. Het werkt!\n")
+request(s, "-L xyz\nDit is een test.\n")
+for _ in range(3):
+    print(receive(s))
+s.close()
+
+print("oversized request")
+s = connect()
+try:
+    s.sendall(struct.pack(">I", 64*1024*1024 + 1) + b"\nDit is een test.\n")
+except OSError:
+    pass
+print(receive(s))
+s.close()
+
+print("truncated request")
+s = connect()
+s.sendall(struct.pack(">I", 100) + b"\nDit is een")
+s.shutdown(socket.SHUT_WR)
+print(receive(s))
+s.close()
+
+print("still serving")
+s = connect()
+request(s, "\nNog een test.\n")
+print(receive(s))
+s.close()
+PYTHON
+
+kill $pid
+wait $pid 2> /dev/null
+\rm -f $sock